@@ -0,0 +1,458 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// CPU encoders for the BCn block compressed formats the GL samples directly, every 4x4 texel block becomes 8 or 16
+// bytes:
+//   BC1 (DXT1)  RGB, two RGB565 endpoints and 2 bit indices, 8 bytes
+//   BC3 (DXT5)  a BC4 block for alpha followed by a BC1 block for RGB, 16 bytes
+//   BC4 (RGTC1) one channel, two 8 bit endpoints and 3 bit indices, 8 bytes
+//   BC5 (RGTC2) two BC4 blocks for red and green, meant for tangent space normal maps, 16 bytes
+//   BC7 (BPTC)  RGBA, only mode 6: one subset with 7 bit endpoints plus a p-bit and 4 bit indices, 16 bytes
+// The endpoints are fitted along the principal axis of the block and refined once by least squares. The index
+// search, where most of the time goes, handles four texels per SSE2 instruction.
+
+enum BlockFormat {
+    BLOCK_BC1,
+    BLOCK_BC3,
+    BLOCK_BC4,
+    BLOCK_BC5,
+    BLOCK_BC7
+};
+
+inline unsigned int blockBytes(BlockFormat format)
+{
+    return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+}
+
+inline size_t compressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// the 16 texels of a block with one row per channel, so four texels of a channel fill an SSE register
+struct BlockTexels {
+    alignas(16) float channels[4][16];
+};
+
+// the closest palette entry over channels [first, first + count) for every texel, returns the summed squared error
+inline float fitBlockIndices(const BlockTexels &texels, unsigned int first, unsigned int count, const float (*palette)[4],
+                             unsigned int paletteSize, unsigned char indices[16])
+{
+    float total = 0.0f;
+#ifdef __SSE2__
+    for (int group = 0; group < 16; group += 4)
+    {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (unsigned int p = 0; p < paletteSize; p++)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (unsigned int c = 0; c < count; c++)
+            {
+                __m128 difference = _mm_sub_ps(_mm_load_ps(&texels.channels[first + c][group]), _mm_set1_ps(palette[p][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(difference, difference));
+            }
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+            best = _mm_min_ps(best, distance);
+        }
+        alignas(16) float errors[4];
+        alignas(16) int32_t chosen[4];
+        _mm_store_ps(errors, best);
+        _mm_store_si128((__m128i*)chosen, bestIndex);
+        for (int i = 0; i < 4; i++)
+        {
+            indices[group + i] = (unsigned char)chosen[i];
+            total += errors[i];
+        }
+    }
+#else
+    for (int i = 0; i < 16; i++)
+    {
+        float best = FLT_MAX;
+        for (unsigned int p = 0; p < paletteSize; p++)
+        {
+            float distance = 0.0f;
+            for (unsigned int c = 0; c < count; c++)
+            {
+                float difference = texels.channels[first + c][i] - palette[p][c];
+                distance += difference * difference;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = (unsigned char)p;
+            }
+        }
+        total += best;
+    }
+#endif
+    return total;
+}
+
+// the two ends of the texels' extent along their principal axis over channels [first, first + count)
+inline void principalEndpoints(const BlockTexels &texels, unsigned int first, unsigned int count, float low[4], float high[4])
+{
+    float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (unsigned int c = 0; c < count; c++)
+    {
+        for (int i = 0; i < 16; i++)
+            mean[c] += texels.channels[first + c][i];
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (unsigned int a = 0; a < count; a++)
+            for (unsigned int b = 0; b < count; b++)
+                covariance[a][b] += (texels.channels[first + a][i] - mean[a]) * (texels.channels[first + b][i] - mean[b]);
+
+    // power iteration, starting from the channel that varies most
+    unsigned int widest = 0;
+    for (unsigned int c = 1; c < count; c++)
+        if (covariance[c][c] > covariance[widest][widest])
+            widest = c;
+    float axis[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (unsigned int c = 0; c < count; c++)
+        axis[c] = covariance[widest][c];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        float length = 0.0f;
+        for (unsigned int a = 0; a < count; a++)
+        {
+            for (unsigned int b = 0; b < count; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length == 0.0f)
+            break;
+        for (unsigned int c = 0; c < count; c++)
+            axis[c] = next[c] / length;
+    }
+    float lengthSquared = 0.0f;
+    for (unsigned int c = 0; c < count; c++)
+        lengthSquared += axis[c] * axis[c];
+    if (lengthSquared == 0.0f)
+    {
+        // a flat block
+        for (unsigned int c = 0; c < count; c++)
+            low[c] = high[c] = mean[c];
+        return;
+    }
+
+    float minimum = FLT_MAX, maximum = -FLT_MAX;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = 0.0f;
+        for (unsigned int c = 0; c < count; c++)
+            projection += (texels.channels[first + c][i] - mean[c]) * axis[c];
+        minimum = std::min(minimum, projection);
+        maximum = std::max(maximum, projection);
+    }
+    for (unsigned int c = 0; c < count; c++)
+    {
+        low[c] = std::min(std::max(mean[c] + axis[c] * minimum / lengthSquared, 0.0f), 255.0f);
+        high[c] = std::min(std::max(mean[c] + axis[c] * maximum / lengthSquared, 0.0f), 255.0f);
+    }
+}
+
+// least squares endpoints for fixed indices, weights[i] is how far palette entry i lies from low towards high.
+// Returns false when the indices don't span a range, the endpoints are left alone then
+inline bool refineEndpoints(const BlockTexels &texels, unsigned int first, unsigned int count, const unsigned char indices[16],
+                            const float *weights, float low[4], float high[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {0.0f, 0.0f, 0.0f, 0.0f}, bx[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float b = weights[indices[i]], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (unsigned int c = 0; c < count; c++)
+        {
+            ax[c] += a * texels.channels[first + c][i];
+            bx[c] += b * texels.channels[first + c][i];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+    for (unsigned int c = 0; c < count; c++)
+    {
+        low[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+        high[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+inline uint16_t packRgb565(const float color[4])
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+inline void unpackRgb565(uint16_t packed, float color[4])
+{
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    color[0] = (float)(r << 3 | r >> 2);
+    color[1] = (float)(g << 2 | g >> 4);
+    color[2] = (float)(b << 3 | b >> 2);
+    color[3] = 255.0f;
+}
+
+// the four colour palette of two RGB565 endpoints and the squared error of the best indices for it
+inline float fitBc1(const BlockTexels &texels, uint16_t color0, uint16_t color1, unsigned char indices[16])
+{
+    float palette[4][4];
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    return fitBlockIndices(texels, 0, 3, palette, 4, indices);
+}
+
+// 8 bytes of RGB, always in four colour mode, so BC3 can use it as is
+inline void encodeBc1Block(const BlockTexels &texels, unsigned char *out)
+{
+    static const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    float low[4], high[4];
+    principalEndpoints(texels, 0, 3, low, high);
+
+    uint16_t color0 = packRgb565(high), color1 = packRgb565(low);
+    unsigned char indices[16];
+    float error = fitBc1(texels, color0, color1, indices);
+
+    // palette entry 0 is color0, the high end
+    if (refineEndpoints(texels, 0, 3, indices, weights, high, low))
+    {
+        uint16_t refined0 = packRgb565(high), refined1 = packRgb565(low);
+        unsigned char refinedIndices[16];
+        float refinedError = fitBc1(texels, refined0, refined1, refinedIndices);
+        if (refinedError < error)
+        {
+            color0 = refined0;
+            color1 = refined1;
+            std::memcpy(indices, refinedIndices, 16);
+        }
+    }
+
+    // color0 > color1 selects four colour mode, swapping the endpoints swaps the palette entries 0/1 and 2/3
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        for (int i = 0; i < 16; i++)
+            indices[i] ^= 1;
+    }
+    else if (color0 == color1)
+        std::memset(indices, 0, 16);
+
+    out[0] = (unsigned char)color0;
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)color1;
+    out[3] = (unsigned char)(color1 >> 8);
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint32_t)indices[i] << (2 * i);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+// 8 bytes for one channel in eight value mode
+inline void encodeBc4Block(const BlockTexels &texels, unsigned int channel, unsigned char *out)
+{
+    float minimum = 255.0f, maximum = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        minimum = std::min(minimum, texels.channels[channel][i]);
+        maximum = std::max(maximum, texels.channels[channel][i]);
+    }
+    int value0 = (int)(maximum + 0.5f), value1 = (int)(minimum + 0.5f);
+
+    unsigned char indices[16] = {};
+    if (value0 > value1)
+    {
+        // entry 0 is value0, 1 is value1 and 2..7 step from value0 to value1
+        float palette[8][4];
+        palette[0][0] = (float)value0;
+        palette[1][0] = (float)value1;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1][0] = (float)(((7 - i) * value0 + i * value1) / 7);
+        fitBlockIndices(texels, channel, 1, palette, 8, indices);
+    }
+
+    out[0] = (unsigned char)value0;
+    out[1] = (unsigned char)value1;
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint64_t)indices[i] << (3 * i);
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+// BC7 mode 6 endpoints: 7 bits per channel and a p-bit that becomes the lowest bit of all four channels
+struct Bc7Endpoint {
+    int values[4];
+    int pbit;
+};
+
+inline Bc7Endpoint quantizeBc7(const float color[4], int pbit)
+{
+    Bc7Endpoint endpoint;
+    endpoint.pbit = pbit;
+    for (int c = 0; c < 4; c++)
+        endpoint.values[c] = std::min(std::max((int)((color[c] - pbit) / 2.0f + 0.5f), 0), 127);
+    return endpoint;
+}
+
+inline float fitBc7(const BlockTexels &texels, const Bc7Endpoint &endpoint0, const Bc7Endpoint &endpoint1, unsigned char indices[16])
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    float palette[16][4];
+    for (int c = 0; c < 4; c++)
+    {
+        int value0 = endpoint0.values[c] << 1 | endpoint0.pbit;
+        int value1 = endpoint1.values[c] << 1 | endpoint1.pbit;
+        for (int i = 0; i < 16; i++)
+            palette[i][c] = (float)(((64 - weights[i]) * value0 + weights[i] * value1 + 32) >> 6);
+    }
+    return fitBlockIndices(texels, 0, 4, palette, 16, indices);
+}
+
+// the best p-bit combination for a pair of endpoints
+inline float fitBc7Endpoints(const BlockTexels &texels, const float low[4], const float high[4], Bc7Endpoint &endpoint0,
+                             Bc7Endpoint &endpoint1, unsigned char indices[16])
+{
+    float best = FLT_MAX;
+    for (int pbits = 0; pbits < 4; pbits++)
+    {
+        Bc7Endpoint candidate0 = quantizeBc7(low, pbits & 1);
+        Bc7Endpoint candidate1 = quantizeBc7(high, pbits >> 1);
+        unsigned char candidateIndices[16];
+        float error = fitBc7(texels, candidate0, candidate1, candidateIndices);
+        if (error < best)
+        {
+            best = error;
+            endpoint0 = candidate0;
+            endpoint1 = candidate1;
+            std::memcpy(indices, candidateIndices, 16);
+        }
+    }
+    return best;
+}
+
+// 16 bytes of RGBA in mode 6
+inline void encodeBc7Block(const BlockTexels &texels, unsigned char *out)
+{
+    static const float weights[16] = {0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+                                      34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64};
+    float low[4], high[4];
+    principalEndpoints(texels, 0, 4, low, high);
+
+    Bc7Endpoint endpoint0, endpoint1;
+    unsigned char indices[16];
+    float error = fitBc7Endpoints(texels, low, high, endpoint0, endpoint1, indices);
+    if (refineEndpoints(texels, 0, 4, indices, weights, low, high))
+    {
+        Bc7Endpoint refined0, refined1;
+        unsigned char refinedIndices[16];
+        if (fitBc7Endpoints(texels, low, high, refined0, refined1, refinedIndices) < error)
+        {
+            endpoint0 = refined0;
+            endpoint1 = refined1;
+            std::memcpy(indices, refinedIndices, 16);
+        }
+    }
+
+    // the first index is stored without its top bit, which therefore has to be 0
+    if (indices[0] & 8)
+    {
+        std::swap(endpoint0, endpoint1);
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    // written from the lowest bit up: mode bits 0000001, R0 R1 G0 G1 B0 B1 A0 A1, P0 P1, then the indices
+    uint64_t bits[2] = {0, 0};
+    unsigned int position = 0;
+    auto write = [&bits, &position](uint64_t value, unsigned int count) {
+        for (unsigned int i = 0; i < count; i++, position++)
+            bits[position / 64] |= (value >> i & 1) << (position % 64);
+    };
+    write(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        write(endpoint0.values[c], 7);
+        write(endpoint1.values[c], 7);
+    }
+    write(endpoint0.pbit, 1);
+    write(endpoint1.pbit, 1);
+    write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        write(indices[i], 4);
+    for (int i = 0; i < 16; i++)
+        out[i] = (unsigned char)(bits[i / 8] >> (8 * (i % 8)));
+}
+
+// compresses the block rows [firstRow, lastRow) of an RGBA8 image into out, which holds the blocks of the whole image.
+// Blocks that stick out of the image repeat its last row and column
+inline void compressBlockRows(const unsigned char *rgba, int width, int height, BlockFormat format, unsigned char *out,
+                              int firstRow, int lastRow)
+{
+    int blocksWide = (width + 3) / 4;
+    unsigned int bytes = blockBytes(format);
+    BlockTexels texels;
+    for (int blockY = firstRow; blockY < lastRow; blockY++)
+    {
+        for (int blockX = 0; blockX < blocksWide; blockX++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(blockX * 4 + i % 4, width - 1), y = std::min(blockY * 4 + i / 4, height - 1);
+                const unsigned char *texel = rgba + ((size_t)y * width + x) * 4;
+                for (int c = 0; c < 4; c++)
+                    texels.channels[c][i] = texel[c];
+            }
+
+            unsigned char *block = out + ((size_t)blockY * blocksWide + blockX) * bytes;
+            switch (format)
+            {
+            case BLOCK_BC1:
+                encodeBc1Block(texels, block);
+                break;
+            case BLOCK_BC3:
+                encodeBc4Block(texels, 3, block);
+                encodeBc1Block(texels, block + 8);
+                break;
+            case BLOCK_BC4:
+                encodeBc4Block(texels, 0, block);
+                break;
+            case BLOCK_BC5:
+                encodeBc4Block(texels, 0, block);
+                encodeBc4Block(texels, 1, block + 8);
+                break;
+            case BLOCK_BC7:
+                encodeBc7Block(texels, block);
+                break;
+            }
+        }
+    }
+}
+
+#endif
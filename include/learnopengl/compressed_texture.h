@@ -0,0 +1,328 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/block_compression.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+// glad is generated without the S3TC and BPTC extensions, RGTC is core since GL 3.0
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// a block compressed image with its mip chain, as a KTX file holds it
+struct CompressedImage {
+    GLenum internalFormat;
+    // GL_RED, GL_RG, GL_RGB or GL_RGBA, the channels of the image it was baked from
+    GLenum baseFormat;
+    int width, height;
+    unsigned int levelCount;
+    // the first row is the bottom one, what the TextureLoader's flip setting produces
+    bool bottomUp;
+    // sourceStamp() of the image it was baked from
+    std::string source;
+    // level i is (width >> i) x (height >> i), empty when only the header was read
+    std::vector<std::vector<unsigned char> > levels;
+};
+
+// Baked images live next to their source as "<image>.ktx", in the KTX 1.1 format with one face and no array layers,
+// so other tools can open them. A baked image replaces its source while the source size and modification time, the
+// flip setting and the context's format support all match, otherwise the source is decoded as before.
+class CompressedTextures {
+public:
+    static std::string bakedPath(const std::string &source)
+    {
+        return source + ".ktx";
+    }
+
+    // size and modification time of source, empty if it can't be read
+    static std::string sourceStamp(const std::string &source)
+    {
+        struct stat status;
+        if (stat(source.c_str(), &status) != 0)
+            return std::string();
+        return std::to_string((uint64_t)status.st_size) + ' ' +
+               std::to_string((int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec);
+    }
+
+    // asks the context which of the formats it samples, main thread once glad is loaded. Until then baked images are
+    // ignored
+    static void loadSupport()
+    {
+        Support &support = getSupport();
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        support.s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+        support.rgtc = major * 10 + minor >= 30;
+        support.bptc = major * 10 + minor >= 42 || hasExtension("GL_ARB_texture_compression_bptc");
+    }
+
+    static bool isSupported(GLenum internalFormat)
+    {
+        const Support &support = getSupport();
+        switch (internalFormat)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return support.s3tc;
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            return support.rgtc;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return support.bptc;
+        }
+        return false;
+    }
+
+    // bytes per 4x4 block, 0 for formats this code doesn't know
+    static unsigned int blockBytes(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+            return 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return 16;
+        }
+        return 0;
+    }
+
+    // the encoder of a format blockBytes() knows
+    static BlockFormat blockFormat(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return BLOCK_BC3;
+        case GL_COMPRESSED_RED_RGTC1:
+            return BLOCK_BC4;
+        case GL_COMPRESSED_RG_RGTC2:
+            return BLOCK_BC5;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return BLOCK_BC7;
+        }
+        return BLOCK_BC1;
+    }
+
+    static size_t levelSize(GLenum internalFormat, int width, int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(internalFormat);
+    }
+
+    static int components(GLenum baseFormat)
+    {
+        switch (baseFormat)
+        {
+        case GL_RED:
+            return 1;
+        case GL_RG:
+            return 2;
+        case GL_RGBA:
+            return 4;
+        }
+        return 3;
+    }
+
+    // reads the header of the baked image of source when it can stand in for source with the given flip setting.
+    // Safe to call from any thread once loadSupport() ran
+    static bool findBaked(const std::string &source, bool flip, CompressedImage &image)
+    {
+        return read(bakedPath(source), false, image) && image.bottomUp == flip && isSupported(image.internalFormat) &&
+               image.source == sourceStamp(source);
+    }
+
+    // reads a KTX file, the mip levels only when withLevels is set
+    static bool read(const std::string &path, bool withLevels, CompressedImage &image)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        unsigned char fileIdentifier[12];
+        Header header;
+        bool ok = fread(fileIdentifier, sizeof(fileIdentifier), 1, file) == 1 &&
+                  std::memcmp(fileIdentifier, identifier(), sizeof(fileIdentifier)) == 0 &&
+                  fread(&header, sizeof(header), 1, file) == 1 && header.endianness == ENDIANNESS && header.glType == 0 &&
+                  header.pixelDepth == 0 && header.numberOfArrayElements == 0 && header.numberOfFaces == 1 &&
+                  header.pixelWidth > 0 && header.pixelHeight > 0 && header.numberOfMipmapLevels > 0 &&
+                  header.numberOfMipmapLevels <= 32 && blockBytes(header.glInternalFormat) > 0;
+
+        std::vector<char> keyValues(ok ? header.bytesOfKeyValueData : 0);
+        ok = ok && (keyValues.empty() || fread(&keyValues[0], 1, keyValues.size(), file) == keyValues.size());
+        if (ok)
+        {
+            image.internalFormat = header.glInternalFormat;
+            image.baseFormat = header.glBaseInternalFormat;
+            image.width = header.pixelWidth;
+            image.height = header.pixelHeight;
+            image.levelCount = header.numberOfMipmapLevels;
+            image.bottomUp = false;
+            image.source.clear();
+            image.levels.clear();
+
+            // uint32 size, "key\0value", padded to 4 bytes
+            size_t offset = 0;
+            while (offset + 4 <= keyValues.size())
+            {
+                uint32_t size;
+                std::memcpy(&size, &keyValues[offset], 4);
+                if (size > keyValues.size() - offset - 4)
+                    break;
+                std::string pair(&keyValues[offset + 4], size);
+                size_t separator = pair.find('\0');
+                std::string key = pair.substr(0, separator);
+                std::string value = separator == std::string::npos ? std::string() : pair.substr(separator + 1);
+                value = value.substr(0, value.find('\0'));
+                if (key == "KTXorientation")
+                    image.bottomUp = value.find("T=u") != std::string::npos;
+                else if (key == sourceKey())
+                    image.source = value;
+                offset += 4 + ((size + 3) & ~3u);
+            }
+        }
+
+        for (unsigned int level = 0; ok && withLevels && level < image.levelCount; level++)
+        {
+            uint32_t size;
+            int width = std::max(image.width >> level, 1), height = std::max(image.height >> level, 1);
+            ok = fread(&size, sizeof(size), 1, file) == 1 && size == levelSize(image.internalFormat, width, height);
+            if (!ok)
+                break;
+            image.levels.push_back(std::vector<unsigned char>(size));
+            // the block sizes are multiples of 4, so there is no padding between levels
+            ok = fread(&image.levels.back()[0], 1, size, file) == size;
+        }
+        fclose(file);
+        return ok;
+    }
+
+    // writes image with all of its levels, under a temporary name that is renamed once complete
+    static bool write(const std::string &path, const CompressedImage &image)
+    {
+        std::string temporary = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file)
+            return false;
+
+        std::vector<char> keyValues;
+        appendKeyValue(keyValues, "KTXorientation", image.bottomUp ? "S=r,T=u" : "S=r,T=d");
+        appendKeyValue(keyValues, sourceKey(), image.source);
+
+        Header header;
+        header.endianness = ENDIANNESS;
+        header.glType = 0;
+        header.glTypeSize = 1;
+        header.glFormat = 0;
+        header.glInternalFormat = image.internalFormat;
+        header.glBaseInternalFormat = image.baseFormat;
+        header.pixelWidth = image.width;
+        header.pixelHeight = image.height;
+        header.pixelDepth = 0;
+        header.numberOfArrayElements = 0;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = image.levels.size();
+        header.bytesOfKeyValueData = keyValues.size();
+
+        bool ok = fwrite(identifier(), 12, 1, file) == 1 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(&keyValues[0], 1, keyValues.size(), file) == keyValues.size();
+        for (unsigned int level = 0; level < image.levels.size() && ok; level++)
+        {
+            uint32_t size = image.levels[level].size();
+            ok = fwrite(&size, sizeof(size), 1, file) == 1 && fwrite(&image.levels[level][0], 1, size, file) == size;
+        }
+
+        ok = fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Support {
+        bool s3tc, rgtc, bptc;
+    };
+
+    // the KTX 1.1 header after the identifier
+    struct Header {
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    // written in the file's byte order, a file from a big endian writer reads as 0x01020304
+    static const uint32_t ENDIANNESS = 0x04030201;
+
+    // "«KTX 11»\r\n\x1A\n"
+    static const unsigned char* identifier()
+    {
+        static const unsigned char bytes[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+        return bytes;
+    }
+
+    static const char* sourceKey()
+    {
+        return "bake.source";
+    }
+
+    static Support& getSupport()
+    {
+        static Support support = {false, false, false};
+        return support;
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+
+    static void appendKeyValue(std::vector<char> &keyValues, const std::string &key, const std::string &value)
+    {
+        uint32_t size = key.size() + 1 + value.size() + 1;
+        size_t offset = keyValues.size();
+        keyValues.resize(offset + 4 + ((size + 3) & ~3u), '\0');
+        std::memcpy(&keyValues[offset], &size, 4);
+        std::memcpy(&keyValues[offset + 4], key.c_str(), key.size() + 1);
+        std::memcpy(&keyValues[offset + 4 + key.size() + 1], value.c_str(), value.size() + 1);
+    }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define FILESYSTEM_H
 
 #include <string>
+#include <climits>
 #include <cstdlib>
 #include "root_directory.h" // This is a configuration file generated by CMake.
 
@@ -17,6 +18,16 @@ public:
     return (*pathBuilder)(path);
   }
 
+  // absolute path with ".", ".." and symlinks resolved, so different spellings of one file compare equal.
+  // paths that can't be resolved, like missing files, are returned unchanged
+  static std::string canonicalPath(const std::string& path)
+  {
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved))
+      return resolved;
+    return path;
+  }
+
 private:
   static std::string const & getRoot()
   {
@@ -0,0 +1,230 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_USE_SSE2
+#endif
+
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// bounds of vertexCount positions stored stride floats apart, the sphere is centered on the box
+inline void computeBounds(const float *positions, unsigned int vertexCount, unsigned int stride, BoundingBox &box, BoundingSphere &sphere)
+{
+    box.min = box.max = glm::vec3(0.0f);
+    sphere.center = glm::vec3(0.0f);
+    sphere.radius = 0.0f;
+    if (vertexCount == 0)
+        return;
+
+    box.min = box.max = glm::vec3(positions[0], positions[1], positions[2]);
+    for (unsigned int i = 1; i < vertexCount; i++)
+    {
+        glm::vec3 position(positions[i * stride], positions[i * stride + 1], positions[i * stride + 2]);
+        box.min = glm::min(box.min, position);
+        box.max = glm::max(box.max, position);
+    }
+
+    sphere.center = (box.min + box.max) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        glm::vec3 offset = glm::vec3(positions[i * stride], positions[i * stride + 1], positions[i * stride + 2]) - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
+}
+
+// texture coordinate units per model space unit of a triangle list, the root of the ratio of the summed texture
+// coordinate and surface areas; 0 for meshes without area. Positions and texCoords are read stride floats apart,
+// indices may be null for count consecutive vertices
+inline float computeUvDensity(const float *positions, const float *texCoords, unsigned int stride, const unsigned int *indices,
+                              unsigned int count)
+{
+    float area = 0.0f, uvArea = 0.0f;
+    for (unsigned int i = 0; i + 2 < count; i += 3)
+    {
+        unsigned int v[3];
+        for (unsigned int k = 0; k < 3; k++)
+            v[k] = (indices ? indices[i + k] : i + k) * stride;
+        glm::vec3 p0(positions[v[0]], positions[v[0] + 1], positions[v[0] + 2]);
+        glm::vec3 p1(positions[v[1]], positions[v[1] + 1], positions[v[1] + 2]);
+        glm::vec3 p2(positions[v[2]], positions[v[2] + 1], positions[v[2] + 2]);
+        area += glm::length(glm::cross(p1 - p0, p2 - p0));
+
+        glm::vec2 t1 = glm::vec2(texCoords[v[1]], texCoords[v[1] + 1]) - glm::vec2(texCoords[v[0]], texCoords[v[0] + 1]);
+        glm::vec2 t2 = glm::vec2(texCoords[v[2]], texCoords[v[2] + 1]) - glm::vec2(texCoords[v[0]], texCoords[v[0] + 1]);
+        uvArea += std::fabs(t1.x * t2.y - t1.y * t2.x);
+    }
+    return area > 0.0f ? std::sqrt(uvArea / area) : 0.0f;
+}
+
+// sphere around the center of box that encloses all the given spheres, used to bound a whole model by its meshes
+inline BoundingSphere mergeBounds(const BoundingBox &box, const BoundingSphere *spheres, unsigned int count)
+{
+    BoundingSphere merged;
+    merged.center = (box.min + box.max) * 0.5f;
+    merged.radius = 0.0f;
+    for (unsigned int i = 0; i < count; i++)
+        merged.radius = std::max(merged.radius, glm::length(spheres[i].center - merged.center) + spheres[i].radius);
+    return merged;
+}
+
+// moves the sphere into the space of transform, the radius grows with the largest axis scale
+inline BoundingSphere transformBounds(const BoundingSphere &sphere, const glm::mat4 &transform)
+{
+    BoundingSphere result;
+    result.center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    result.radius = sphere.radius * scale;
+    return result;
+}
+
+// Bounding spheres stored as separate x, y, z and radius arrays, padded to a multiple of four so the SSE path can
+// always load whole registers. Padding spheres have a negative infinite radius and are never visible.
+class SphereSet {
+public:
+    std::vector<float> x, y, z, radius;
+
+    SphereSet() : count(0) {}
+
+    void add(const BoundingSphere &sphere)
+    {
+        if (count == x.size())
+        {
+            for (unsigned int i = 0; i < 4; i++)
+            {
+                x.push_back(0.0f);
+                y.push_back(0.0f);
+                z.push_back(0.0f);
+                radius.push_back(-INFINITY);
+            }
+        }
+        x[count] = sphere.center.x;
+        y[count] = sphere.center.y;
+        z[count] = sphere.center.z;
+        radius[count] = sphere.radius;
+        count++;
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius.clear();
+        count = 0;
+    }
+
+    unsigned int size() const
+    {
+        return count;
+    }
+
+private:
+    unsigned int count;
+};
+
+// The six clip planes of a view projection matrix (Gribb/Hartmann), normalized so plane distances are in world units.
+class Frustum {
+public:
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        extract(viewProjection);
+    }
+
+    void extract(const glm::mat4 &viewProjection)
+    {
+        // rows of the matrix, glm stores columns
+        glm::vec4 row[4];
+        for (unsigned int i = 0; i < 4; i++)
+            row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        planes[0] = row[3] + row[0]; // left
+        planes[1] = row[3] - row[0]; // right
+        planes[2] = row[3] + row[1]; // bottom
+        planes[3] = row[3] - row[1]; // top
+        planes[4] = row[3] + row[2]; // near
+        planes[5] = row[3] - row[2]; // far
+        for (unsigned int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    bool intersects(const BoundingSphere &sphere) const
+    {
+        for (unsigned int i = 0; i < 6; i++)
+            if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+                return false;
+        return true;
+    }
+
+    // appends the indices of the visible spheres to visible and returns how many were appended
+    unsigned int cull(const SphereSet &spheres, std::vector<unsigned int> &visible) const
+    {
+        unsigned int before = visible.size();
+        unsigned int count = spheres.size();
+#ifdef FRUSTUM_USE_SSE2
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (unsigned int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+        }
+
+        for (unsigned int i = 0; i < count; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&spheres.x[i]);
+            __m128 y = _mm_loadu_ps(&spheres.y[i]);
+            __m128 z = _mm_loadu_ps(&spheres.z[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (unsigned int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+                                             _mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (unsigned int lane = 0; lane < 4 && i + lane < count; lane++)
+                if (mask & (1 << lane))
+                    visible.push_back(i + lane);
+        }
+#else
+        for (unsigned int i = 0; i < count; i++)
+        {
+            BoundingSphere sphere;
+            sphere.center = glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+            sphere.radius = spheres.radius[i];
+            if (intersects(sphere))
+                visible.push_back(i);
+        }
+#endif
+        return visible.size() - before;
+    }
+
+private:
+    glm::vec4 planes[6];
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// first fit allocator over a linear range, free blocks are kept sorted by offset and merged with their neighbours
+class FreeList {
+public:
+    FreeList() : capacity(0), used(0) {}
+
+    // returns false if no free block is large enough
+    bool allocate(size_t size, size_t alignment, size_t &offset)
+    {
+        for (unsigned int i = 0; i < blocks.size(); i++)
+        {
+            size_t aligned = (blocks[i].offset + alignment - 1) / alignment * alignment;
+            size_t padding = aligned - blocks[i].offset;
+            if (blocks[i].size < padding + size)
+                continue;
+
+            offset = aligned;
+            Block rest = {aligned + size, blocks[i].size - padding - size};
+            if (padding > 0)
+            {
+                blocks[i].size = padding;
+                if (rest.size > 0)
+                    blocks.insert(blocks.begin() + i + 1, rest);
+            }
+            else if (rest.size > 0)
+                blocks[i] = rest;
+            else
+                blocks.erase(blocks.begin() + i);
+            used += size;
+            return true;
+        }
+        return false;
+    }
+
+    void free(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        used -= size;
+        Block block = {offset, size};
+        std::vector<Block>::iterator next = std::lower_bound(blocks.begin(), blocks.end(), block,
+                                                             [](const Block &a, const Block &b) { return a.offset < b.offset; });
+        next = blocks.insert(next, block);
+        // merge with the following and the preceding block
+        if (next + 1 != blocks.end() && next->offset + next->size == (next + 1)->offset)
+        {
+            next->size += (next + 1)->size;
+            blocks.erase(next + 1);
+        }
+        if (next != blocks.begin() && (next - 1)->offset + (next - 1)->size == next->offset)
+        {
+            (next - 1)->size += next->size;
+            blocks.erase(next);
+        }
+    }
+
+    // adds the space between the old and the new capacity
+    void grow(size_t newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        size_t added = newCapacity - capacity;
+        size_t start = capacity;
+        capacity = newCapacity;
+        used += added;
+        free(start, added);
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    size_t getUsed() const
+    {
+        return used;
+    }
+
+private:
+    struct Block {
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t capacity;
+    size_t used;
+};
+
+// where a mesh lives inside a GeometryArena
+struct ArenaRange {
+    // first vertex, passed as the base vertex of the draw
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+    // byte offset of the first index in the element buffer
+    size_t indexOffset;
+    size_t indexBytes;
+};
+
+// One vertex and one element buffer shared by every mesh of a vertex format, with one VAO describing them. Meshes
+// are sub-allocated from free lists and drawn with glDrawElementsBaseVertex, so consecutive draws of different meshes
+// don't switch VAOs and meshes can be freed and reallocated while streaming. The buffers grow by copying on the GPU
+// when they run out of space; the VAOs are pointed at the new buffers.
+//
+// The element buffer can hold 16 and 32 bit indices side by side, every allocation is aligned to 4 bytes.
+class GeometryArena {
+public:
+    typedef void (*AttributeSetup)();
+
+    // setupAttributes enables and points the vertex attributes of the format at the bound GL_ARRAY_BUFFER
+    GeometryArena(unsigned int vertexStride, AttributeSetup setupAttributes)
+        : stride(vertexStride), setupAttributes(setupAttributes), vbo(0), ebo(0), vao(0) {}
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copies vertexCount vertices of the arena's stride and indexBytes of indices into the arena
+    ArenaRange allocate(const void *vertexData, unsigned int vertexCount, const void *indexData, size_t indexBytes)
+    {
+        if (vao == 0)
+            create();
+
+        ArenaRange range;
+        size_t vertexOffset;
+        if (!vertices.allocate(vertexCount, 1, vertexOffset))
+        {
+            growVertices(vertices.getCapacity() + vertexCount);
+            vertices.allocate(vertexCount, 1, vertexOffset);
+        }
+        if (!indices.allocate(indexBytes, 4, range.indexOffset))
+        {
+            growIndices(indices.getCapacity() + indexBytes + 4);
+            indices.allocate(indexBytes, 4, range.indexOffset);
+        }
+        range.baseVertex = vertexOffset;
+        range.vertexCount = vertexCount;
+        range.indexBytes = indexBytes;
+
+        // the copy targets leave the element buffer binding of the bound VAO alone
+        if (vertexCount > 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * stride, (size_t)vertexCount * stride, vertexData);
+        }
+        if (indexBytes > 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset, indexBytes, indexData);
+        }
+        return range;
+    }
+
+    void free(const ArenaRange &range)
+    {
+        vertices.free(range.baseVertex, range.vertexCount);
+        indices.free(range.indexOffset, range.indexBytes);
+    }
+
+    // the VAO every draw from the arena can use
+    unsigned int getVertexArray()
+    {
+        if (vao == 0)
+            create();
+        return vao;
+    }
+
+    // another VAO over the arena buffers that the caller can add attributes to, like per instance data
+    unsigned int createVertexArray()
+    {
+        if (vao == 0)
+            create();
+        unsigned int extra;
+        glGenVertexArrays(1, &extra);
+        extraVertexArrays.push_back(extra);
+        attach(extra);
+        return extra;
+    }
+
+    void destroyVertexArray(unsigned int extra)
+    {
+        std::vector<unsigned int>::iterator it = std::find(extraVertexArrays.begin(), extraVertexArrays.end(), extra);
+        if (it == extraVertexArrays.end())
+            return;
+        extraVertexArrays.erase(it);
+        GLState::get().invalidate();
+        glDeleteVertexArrays(1, &extra);
+    }
+
+    // bytes in use and allocated on the GPU
+    size_t usedBytes() const
+    {
+        return vertices.getUsed() * stride + indices.getUsed();
+    }
+
+    size_t capacityBytes() const
+    {
+        return vertices.getCapacity() * stride + indices.getCapacity();
+    }
+
+    // deletes the GL objects, needs the GL context
+    void release()
+    {
+        if (vao == 0)
+            return;
+        GLState::get().invalidate();
+        for (unsigned int i = 0; i < extraVertexArrays.size(); i++)
+            glDeleteVertexArrays(1, &extraVertexArrays[i]);
+        extraVertexArrays.clear();
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        vao = vbo = ebo = 0;
+        vertices = FreeList();
+        indices = FreeList();
+    }
+
+private:
+    // initial sizes, enough for the furniture without growing
+    static const unsigned int INITIAL_VERTICES = 1 << 18;
+    static const unsigned int INITIAL_INDEX_BYTES = 1 << 22;
+
+    unsigned int stride;
+    AttributeSetup setupAttributes;
+    unsigned int vbo, ebo, vao;
+    std::vector<unsigned int> extraVertexArrays;
+    // vertices are counted in vertices so offsets are base vertices, indices in bytes
+    FreeList vertices;
+    FreeList indices;
+
+    void create()
+    {
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (size_t)INITIAL_VERTICES * stride, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_INDEX_BYTES, nullptr, GL_STATIC_DRAW);
+        vertices.grow(INITIAL_VERTICES);
+        indices.grow(INITIAL_INDEX_BYTES);
+
+        glGenVertexArrays(1, &vao);
+        attach(vao);
+    }
+
+    // points the format attributes and the element buffer of vertexArray at the current buffers
+    void attach(unsigned int vertexArray)
+    {
+        GLState::get().bindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        setupAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        GLState::get().bindVertexArray(0);
+    }
+
+    // the new buffer is at least twice as large, so the copies amortize
+    static unsigned int grownBuffer(unsigned int old, size_t oldSize, size_t newSize)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, old);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        glDeleteBuffers(1, &old);
+        return buffer;
+    }
+
+    void growVertices(size_t required)
+    {
+        size_t capacity = std::max(required, vertices.getCapacity() * 2);
+        vbo = grownBuffer(vbo, vertices.getCapacity() * stride, capacity * stride);
+        vertices.grow(capacity);
+        reattach();
+    }
+
+    void growIndices(size_t required)
+    {
+        size_t capacity = std::max(required, indices.getCapacity() * 2);
+        ebo = grownBuffer(ebo, indices.getCapacity(), capacity);
+        indices.grow(capacity);
+        reattach();
+    }
+
+    // attribute pointers keep the buffer they were set up with, so every VAO has to be set up again; attributes the
+    // owners of extra VAOs added for other buffers stay as they are
+    void reattach()
+    {
+        attach(vao);
+        for (unsigned int i = 0; i < extraVertexArrays.size(); i++)
+            attach(extraVertexArrays[i]);
+    }
+};
+
+#endif
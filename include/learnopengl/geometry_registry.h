@@ -0,0 +1,171 @@
+#ifndef GEOMETRY_REGISTRY_H
+#define GEOMETRY_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+
+#include <vector>
+
+// vertex layouts used by the static (non-model) scene geometry
+enum VertexLayout {
+    LAYOUT_POSITION,                       // position
+    LAYOUT_POSITION_NORMAL_UV,             // position, normal, texture coords
+    LAYOUT_POSITION_NORMAL_UV_TANGENT,     // position, normal, texture coords, tangent, bitangent
+    LAYOUT_COUNT
+};
+
+typedef unsigned int GeometryHandle;
+
+struct StaticMesh {
+    VertexLayout layout;
+    // range of vertices inside the vertex buffer of the layout
+    unsigned int first;
+    unsigned int count;
+    // model space bounds of the vertices
+    BoundingBox box;
+    BoundingSphere bounds;
+    // texture coordinate units per model space unit, 0 for layouts without texture coordinates
+    float uvDensity;
+};
+
+// Owns the GL buffers of all static geometry. Meshes are collected with add() during startup and uploaded once by
+// upload(); every mesh of the same layout lives in one shared vertex buffer and VAO, so the render loop only binds a
+// VAO and issues a draw through the handle returned by add().
+class GeometryRegistry {
+public:
+    GeometryRegistry() : uploaded(false)
+    {
+        for (unsigned int i = 0; i < LAYOUT_COUNT; i++)
+            VAO[i] = VBO[i] = 0;
+    }
+
+    GeometryRegistry(const GeometryRegistry&) = delete;
+    GeometryRegistry& operator=(const GeometryRegistry&) = delete;
+
+    // copies the interleaved vertex data of a mesh into the staging buffer of its layout
+    GeometryHandle add(VertexLayout layout, const float *vertices, unsigned int floatCount)
+    {
+        std::vector<float>& buffer = staging[layout];
+        unsigned int stride = floatsPerVertex(layout);
+
+        StaticMesh mesh;
+        mesh.layout = layout;
+        mesh.first = buffer.size() / stride;
+        mesh.count = floatCount / stride;
+        computeBounds(vertices, mesh.count, stride, mesh.box, mesh.bounds);
+        // the texture coordinates follow position and normal
+        mesh.uvDensity = layout == LAYOUT_POSITION ? 0.0f : computeUvDensity(vertices, vertices + 6, stride, nullptr, mesh.count);
+        buffer.insert(buffer.end(), vertices, vertices + floatCount);
+
+        meshes.push_back(mesh);
+        return meshes.size() - 1;
+    }
+
+    // creates one VAO/VBO per used layout and uploads all staged vertices; the staging memory is released afterwards
+    void upload()
+    {
+        if (uploaded)
+            return;
+
+        for (unsigned int layout = 0; layout < LAYOUT_COUNT; layout++)
+        {
+            std::vector<float>& buffer = staging[layout];
+            if (buffer.empty())
+                continue;
+
+            glGenVertexArrays(1, &VAO[layout]);
+            glGenBuffers(1, &VBO[layout]);
+            GLState::get().bindVertexArray(VAO[layout]);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO[layout]);
+            glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), &buffer[0], GL_STATIC_DRAW);
+
+            unsigned int stride = floatsPerVertex((VertexLayout)layout) * sizeof(float);
+            unsigned int offset = 0;
+            const unsigned int *sizes = attributeSizes((VertexLayout)layout);
+            for (unsigned int attribute = 0; sizes[attribute] != 0; attribute++)
+            {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribPointer(attribute, sizes[attribute], GL_FLOAT, GL_FALSE, stride, (void*)(offset * sizeof(float)));
+                offset += sizes[attribute];
+            }
+
+            std::vector<float>().swap(buffer);
+        }
+        GLState::get().bindVertexArray(0);
+        uploaded = true;
+    }
+
+    // draws the whole mesh
+    void draw(GeometryHandle handle) const
+    {
+        draw(handle, meshes[handle].count);
+    }
+
+    // draws only the first count vertices of the mesh
+    void draw(GeometryHandle handle, unsigned int count) const
+    {
+        const StaticMesh& mesh = meshes[handle];
+        GLState::get().bindVertexArray(VAO[mesh.layout]);
+        glDrawArrays(GL_TRIANGLES, mesh.first, count);
+    }
+
+    unsigned int getVertexArray(GeometryHandle handle) const
+    {
+        return VAO[meshes[handle].layout];
+    }
+
+    const StaticMesh& get(GeometryHandle handle) const
+    {
+        return meshes[handle];
+    }
+
+    // deletes all GL objects, must be called while the context is still current
+    void release()
+    {
+        // the deleted VAO names may be handed out again
+        GLState::get().invalidate();
+        for (unsigned int i = 0; i < LAYOUT_COUNT; i++)
+        {
+            if (VAO[i])
+                glDeleteVertexArrays(1, &VAO[i]);
+            if (VBO[i])
+                glDeleteBuffers(1, &VBO[i]);
+            VAO[i] = VBO[i] = 0;
+        }
+        meshes.clear();
+        uploaded = false;
+    }
+
+private:
+    std::vector<StaticMesh> meshes;
+    std::vector<float> staging[LAYOUT_COUNT];
+    unsigned int VAO[LAYOUT_COUNT];
+    unsigned int VBO[LAYOUT_COUNT];
+    bool uploaded;
+
+    // zero terminated list of float counts of each attribute
+    static const unsigned int* attributeSizes(VertexLayout layout)
+    {
+        static const unsigned int position[] = {3, 0};
+        static const unsigned int positionNormalUv[] = {3, 3, 2, 0};
+        static const unsigned int positionNormalUvTangent[] = {3, 3, 2, 3, 3, 0};
+        switch (layout)
+        {
+            case LAYOUT_POSITION: return position;
+            case LAYOUT_POSITION_NORMAL_UV: return positionNormalUv;
+            default: return positionNormalUvTangent;
+        }
+    }
+
+    static unsigned int floatsPerVertex(VertexLayout layout)
+    {
+        unsigned int floats = 0;
+        for (const unsigned int *size = attributeSizes(layout); *size != 0; size++)
+            floats += *size;
+        return floats;
+    }
+};
+
+#endif
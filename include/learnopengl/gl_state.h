@@ -0,0 +1,237 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the renderer touches. All program, VAO, texture and fixed function changes go through
+// GLState::get() so calls that would not change anything are skipped. Code that changes this state behind its back
+// (or deletes a bound object) has to call invalidate() afterwards; ImGui restores everything it touches itself.
+class GLState {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    // calls issued and skipped during one frame
+    struct Stats {
+        unsigned int issued;
+        unsigned int elided;
+    };
+
+    static GLState& get()
+    {
+        static GLState state;
+        return state;
+    }
+
+    GLState(const GLState&) = delete;
+    GLState& operator=(const GLState&) = delete;
+
+    void useProgram(unsigned int program)
+    {
+        if (program == currentProgram)
+        {
+            frame.elided++;
+            return;
+        }
+        glUseProgram(program);
+        currentProgram = program;
+        frame.issued++;
+    }
+
+    void bindVertexArray(unsigned int vao)
+    {
+        if (vao == currentVAO)
+        {
+            frame.elided++;
+            return;
+        }
+        glBindVertexArray(vao);
+        currentVAO = vao;
+        frame.issued++;
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (unit == activeUnit)
+        {
+            frame.elided++;
+            return;
+        }
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        frame.issued++;
+    }
+
+    // binds texture to target on the given unit, the active unit is only switched when the binding changes so it is not
+    // guaranteed to be unit afterwards
+    void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+    {
+        unsigned int &bound = textures[unit][targetIndex(target)];
+        if (bound == texture)
+        {
+            frame.elided++;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        bound = texture;
+        frame.issued++;
+    }
+
+    // binds texture on unit 0 and makes unit 0 active, for glTex* calls that act on whatever is bound to the active unit
+    void bindTextureForEdit(GLenum target, unsigned int texture)
+    {
+        activeTexture(0);
+        bindTexture(0, target, texture);
+    }
+
+    // GL_BLEND, GL_CULL_FACE and GL_DEPTH_TEST are tracked, other capabilities are passed through
+    void enable(GLenum capability)
+    {
+        setCapability(capability, true);
+    }
+
+    void disable(GLenum capability)
+    {
+        setCapability(capability, false);
+    }
+
+    void cullFace(GLenum mode)
+    {
+        if (mode == currentCullFace)
+        {
+            frame.elided++;
+            return;
+        }
+        glCullFace(mode);
+        currentCullFace = mode;
+        frame.issued++;
+    }
+
+    void depthFunc(GLenum func)
+    {
+        if (func == currentDepthFunc)
+        {
+            frame.elided++;
+            return;
+        }
+        glDepthFunc(func);
+        currentDepthFunc = func;
+        frame.issued++;
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if (source == blendSource && destination == blendDestination)
+        {
+            frame.elided++;
+            return;
+        }
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+        frame.issued++;
+    }
+
+    unsigned int getProgram() const
+    {
+        return currentProgram;
+    }
+
+    // forgets everything, the next call of every kind reaches GL again
+    void invalidate()
+    {
+        currentProgram = UNKNOWN;
+        currentVAO = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (unsigned int target = 0; target < TARGET_COUNT; target++)
+                textures[unit][target] = UNKNOWN;
+        for (unsigned int i = 0; i < CAPABILITY_COUNT; i++)
+            capabilities[i] = -1;
+        currentCullFace = UNKNOWN;
+        currentDepthFunc = UNKNOWN;
+        blendSource = blendDestination = UNKNOWN;
+    }
+
+    // a deleted texture name may be reused by glGenTextures, so its shadowed bindings must not survive the delete
+    void forgetTexture(unsigned int texture)
+    {
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (unsigned int target = 0; target < TARGET_COUNT; target++)
+                if (textures[unit][target] == texture)
+                    textures[unit][target] = UNKNOWN;
+    }
+
+    // starts counting a new frame, the counts of the finished one stay available through lastFrame()
+    void beginFrame()
+    {
+        previous = frame;
+        frame.issued = frame.elided = 0;
+    }
+
+    const Stats& lastFrame() const
+    {
+        return previous;
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    enum { TARGET_2D, TARGET_2D_ARRAY, TARGET_CUBE_MAP, TARGET_COUNT };
+    enum { CAPABILITY_BLEND, CAPABILITY_CULL_FACE, CAPABILITY_DEPTH_TEST, CAPABILITY_COUNT };
+
+    unsigned int currentProgram;
+    unsigned int currentVAO;
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS][TARGET_COUNT];
+    // -1 unknown, 0 disabled, 1 enabled
+    int capabilities[CAPABILITY_COUNT];
+    GLenum currentCullFace;
+    GLenum currentDepthFunc;
+    GLenum blendSource, blendDestination;
+    Stats frame;
+    Stats previous;
+
+    GLState()
+    {
+        invalidate();
+        frame.issued = frame.elided = 0;
+        previous = frame;
+    }
+
+    static unsigned int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+            case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+            case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+            default: return TARGET_2D;
+        }
+    }
+
+    void setCapability(GLenum capability, bool enabled)
+    {
+        int index;
+        switch (capability)
+        {
+            case GL_BLEND: index = CAPABILITY_BLEND; break;
+            case GL_CULL_FACE: index = CAPABILITY_CULL_FACE; break;
+            case GL_DEPTH_TEST: index = CAPABILITY_DEPTH_TEST; break;
+            default: index = -1; break;
+        }
+
+        if (index >= 0 && capabilities[index] == (int)enabled)
+        {
+            frame.elided++;
+            return;
+        }
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        if (index >= 0)
+            capabilities[index] = enabled;
+        frame.issued++;
+    }
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// glad is generated for GL 3.3, the GL 4.3 multi draw indirect pieces are loaded by hand
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+// records of the GL_DRAW_INDIRECT_BUFFER, laid out as the GL spec defines them
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+// per draw entry of the storage buffer the indirect vertex shaders index with drawBase + gl_DrawIDARB, std430
+struct IndirectDrawData {
+    glm::mat4 model;
+    float positionOffset[3];
+    // texture array layers of the material, see Material::getLayers
+    uint32_t diffuseLayer;
+    float positionScale[3];
+    uint32_t specularLayer;
+};
+
+// Multi draw indirect support (GL 4.3 with ARB_shader_draw_parameters for gl_DrawIDARB) and the two buffers a frame
+// of batched draws is written to. Records are collected on the CPU during a flush, uploaded once with upload() and
+// then drawn batch by batch from byte offsets into the indirect buffer.
+class MultiDrawIndirect {
+public:
+    // storage buffer binding point of the per draw data, matches the binding in the indirect vertex shaders
+    static const unsigned int DRAW_DATA_BINDING = 0;
+
+    // loads the entry points with the loader glad was initialized with, returns whether the context supports the path
+    static bool load(GLADloadproc loader)
+    {
+        Functions &gl = functions();
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        int version = major * 10 + minor;
+        bool drawParameters = version >= 46 || hasExtension("GL_ARB_shader_draw_parameters");
+        if (version < 43 || !drawParameters)
+            return gl.supported = false;
+
+        gl.multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)loader("glMultiDrawElementsIndirect");
+        gl.multiDrawArraysIndirect = (MultiDrawArraysIndirectProc)loader("glMultiDrawArraysIndirect");
+        gl.supported = gl.multiDrawElementsIndirect && gl.multiDrawArraysIndirect;
+        return gl.supported;
+    }
+
+    static bool isSupported()
+    {
+        return functions().supported;
+    }
+
+    MultiDrawIndirect() : indirectBuffer(0), drawDataBuffer(0), indirectCapacity(0), drawDataCapacity(0) {}
+
+    MultiDrawIndirect(const MultiDrawIndirect&) = delete;
+    MultiDrawIndirect& operator=(const MultiDrawIndirect&) = delete;
+
+    void clear()
+    {
+        commands.clear();
+        drawData.clear();
+    }
+
+    // appends a record, returns its byte offset in the indirect buffer
+    size_t addElements(unsigned int count, unsigned int firstIndex, int baseVertex, unsigned int instanceCount)
+    {
+        DrawElementsIndirectCommand command = {count, instanceCount, firstIndex, baseVertex, 0};
+        return append(&command, sizeof(command));
+    }
+
+    size_t addArrays(unsigned int count, unsigned int first, unsigned int instanceCount)
+    {
+        DrawArraysIndirectCommand command = {count, instanceCount, first, 0};
+        return append(&command, sizeof(command));
+    }
+
+    // appends the data of the next draw, returns its index in the storage buffer
+    unsigned int addDrawData(const IndirectDrawData &data)
+    {
+        drawData.push_back(data);
+        return drawData.size() - 1;
+    }
+
+    // uploads the records of the frame and leaves both buffers bound for the draws
+    void upload()
+    {
+        if (commands.empty())
+            return;
+        if (indirectBuffer == 0)
+        {
+            glGenBuffers(1, &indirectBuffer);
+            glGenBuffers(1, &drawDataBuffer);
+        }
+        // orphaned every frame, the driver hands out fresh storage while the previous frame may still read the old one
+        uploadBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer, indirectCapacity, &commands[0], commands.size());
+        uploadBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer, drawDataCapacity, &drawData[0], drawData.size() * sizeof(IndirectDrawData));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+    }
+
+    void drawElements(GLenum indexType, size_t offset, unsigned int drawCount) const
+    {
+        functions().multiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)offset, drawCount, 0);
+    }
+
+    void drawArrays(size_t offset, unsigned int drawCount) const
+    {
+        functions().multiDrawArraysIndirect(GL_TRIANGLES, (const void*)offset, drawCount, 0);
+    }
+
+    // deletes the buffers, needs the GL context
+    void release()
+    {
+        if (indirectBuffer == 0)
+            return;
+        glDeleteBuffers(1, &indirectBuffer);
+        glDeleteBuffers(1, &drawDataBuffer);
+        indirectBuffer = drawDataBuffer = 0;
+        indirectCapacity = drawDataCapacity = 0;
+    }
+
+private:
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+    typedef void (APIENTRYP MultiDrawArraysIndirectProc)(GLenum mode, const void *indirect, GLsizei drawCount, GLsizei stride);
+
+    struct Functions {
+        bool supported;
+        MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+        MultiDrawArraysIndirectProc multiDrawArraysIndirect;
+    };
+
+    unsigned int indirectBuffer, drawDataBuffer;
+    size_t indirectCapacity, drawDataCapacity;
+    // both record types packed back to back, every record is a multiple of 4 bytes as the offsets require
+    std::vector<unsigned char> commands;
+    std::vector<IndirectDrawData> drawData;
+
+    static Functions& functions()
+    {
+        static Functions gl = {false, nullptr, nullptr};
+        return gl;
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+
+    size_t append(const void *record, size_t size)
+    {
+        size_t offset = commands.size();
+        commands.resize(offset + size);
+        std::memcpy(&commands[offset], record, size);
+        return offset;
+    }
+
+    // the buffer only grows, to twice the size it ran out at
+    static void uploadBuffer(GLenum target, unsigned int buffer, size_t &capacity, const void *data, size_t size)
+    {
+        glBindBuffer(target, buffer);
+        if (size > capacity)
+            capacity = std::max(size, capacity * 2);
+        glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, size, data);
+    }
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/uniform.h>
+
+#include <string>
+#include <vector>
+
+// texture slots of a material, the shaders name their samplers <prefix>texture_<type>N
+enum TextureType {
+    TEXTURE_DIFFUSE,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT,
+    TEXTURE_TYPE_COUNT
+};
+
+inline const char* textureTypeName(TextureType type)
+{
+    static const char* names[TEXTURE_TYPE_COUNT] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+    return names[type];
+}
+
+struct MaterialTexture {
+    unsigned int id;
+    GLenum target;
+    TextureType type;
+    // the N in texture_diffuseN, counted per type starting at 1
+    unsigned int number;
+    // layer of a GL_TEXTURE_2D_ARRAY texture, 0 otherwise
+    unsigned int layer;
+};
+
+// The textures of a mesh in texture unit order. Sampler names are resolved once per shader the material is drawn with
+// and kept as uniform handles, so bind() is a loop of cached texture binds and sampler uniforms and never allocates.
+//
+// Textures from a TextureArrayPacker array also carry their layer. The layers of the first diffuse and specular
+// texture go to the "materialLayers" uniform, which the vertex shaders pass on to the samplers; materials that only
+// differ in their layers bind the same textures, see sharesTextures().
+class Material {
+public:
+    Material() : layers(0, 0) {}
+
+    // appends a texture on the next free texture unit
+    void add(unsigned int id, TextureType type, GLenum target = GL_TEXTURE_2D, unsigned int layer = 0)
+    {
+        unsigned int number = 1;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            if (textures[i].type == type)
+                number++;
+
+        MaterialTexture texture;
+        texture.id = id;
+        texture.target = target;
+        texture.type = type;
+        texture.number = number;
+        texture.layer = layer;
+        textures.push_back(texture);
+        shaderBindings.clear();
+
+        if (number == 1 && type == TEXTURE_DIFFUSE)
+            layers.x = layer;
+        if (number == 1 && type == TEXTURE_SPECULAR)
+            layers.y = layer;
+    }
+
+    // prefix of the sampler names, e.g. "material." for samplers inside a Material struct
+    void setPrefix(const std::string &prefix)
+    {
+        samplerPrefix = prefix;
+        shaderBindings.clear();
+    }
+
+    const std::vector<MaterialTexture>& getTextures() const
+    {
+        return textures;
+    }
+
+    // layers of the first diffuse (x) and specular (y) texture
+    const glm::ivec2& getLayers() const
+    {
+        return layers;
+    }
+
+    // whether both materials bind the same textures to the same units, their layers may differ
+    bool sharesTextures(const Material &other) const
+    {
+        if (textures.size() != other.textures.size())
+            return false;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || textures[i].target != other.textures[i].target ||
+                textures[i].type != other.textures[i].type)
+                return false;
+        return true;
+    }
+
+    // binds every texture to its unit and points the matching samplers of the bound shader at them
+    void bind(const Shader &shader) const
+    {
+        const ShaderBinding &binding = bindingFor(shader);
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            GLState::get().bindTexture(i, textures[i].target, textures[i].id);
+            binding.samplers[i].set(i);
+        }
+        binding.layers.set(layers);
+    }
+
+private:
+    // sampler handles of one shader, indexed like textures
+    struct ShaderBinding {
+        unsigned int program;
+        std::vector<Uniform<int> > samplers;
+        Uniform<glm::ivec2> layers;
+    };
+
+    std::vector<MaterialTexture> textures;
+    glm::ivec2 layers;
+    std::string samplerPrefix;
+    // a mesh is drawn with only a handful of shaders, a linear search beats hashing here
+    mutable std::vector<ShaderBinding> shaderBindings;
+
+    const ShaderBinding& bindingFor(const Shader &shader) const
+    {
+        for (unsigned int i = 0; i < shaderBindings.size(); i++)
+            if (shaderBindings[i].program == shader.ID)
+                return shaderBindings[i];
+
+        ShaderBinding binding;
+        binding.program = shader.ID;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            std::string name = samplerPrefix + textureTypeName(textures[i].type) + std::to_string(textures[i].number);
+            binding.samplers.push_back(shader.getUniform<int>(name));
+        }
+        binding.layers = shader.getUniform<glm::ivec2>("materialLayers");
+        shaderBindings.push_back(binding);
+        return shaderBindings.back();
+    }
+};
+
+#endif
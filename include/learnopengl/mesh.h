@@ -6,8 +6,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/material.h>
+#include <learnopengl/vertex_format.h>
 
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -28,112 +34,245 @@ struct Vertex {
 
 
 struct Texture {
+    // a GL_TEXTURE_2D_ARRAY from the TextureArrayPacker for model textures
     unsigned int id;
-    string type;
+    unsigned int layer;
+    TextureType type;
     string path;
+    // TextureRegistry::hashFile of the image, 0 if unknown
+    uint64_t hash;
 };
 
+// vertex attributes of the float layout, for the bound GL_ARRAY_BUFFER
+inline void setupVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// vertex attributes of the PackedVertex layout, for the bound GL_ARRAY_BUFFER
+inline void setupPackedVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    // vertex normals, w is the bitangent handedness
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+    // octahedral vertex tangent, the float layout uses locations 3 and 4 instead
+    glEnableVertexAttribArray(9);
+    glVertexAttribPointer(9, 2, GL_BYTE, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
+}
+
+// the arena all meshes of one vertex layout are uploaded into, released before the context goes away
+inline GeometryArena& meshArena(bool compact)
+{
+    static GeometryArena vertexArena(sizeof(Vertex), setupVertexAttributes);
+    static GeometryArena packedArena(sizeof(PackedVertex), setupPackedVertexAttributes);
+    return compact ? packedArena : vertexArena;
+}
+
+// sources the per-instance model matrix (attribute locations 5-8, one vec4 column each) of vao from instanceVBO
+inline void setupInstanceAttributes(unsigned int vao, unsigned int instanceVBO)
+{
+    GLState::get().bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(5 + i);
+        glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(5 + i, 1);
+    }
+    GLState::get().bindVertexArray(0);
+}
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
+    // texture files of the mesh, turned into the material once the textures are requested on the main thread
     vector<Texture>      textures;
+    Material             material;
+    // model space bounds, filled by Model::processMesh
+    BoundingBox          boundingBox;
+    BoundingSphere       boundingSphere;
+    // texture coordinate units per model space unit, filled by Model::processMesh; 0 when unknown
+    float                uvDensity;
 
+    // vertex buffer layout chosen by upload(), PackedVertex positions decode as positionOffset + positionScale * value
+    bool                 compact;
+    glm::vec3            positionOffset;
+    glm::vec3            positionScale;
+    // GL_UNSIGNED_SHORT when every vertex can be addressed with 16 bits, otherwise GL_UNSIGNED_INT; set by upload()
+    GLenum               indexType;
+    // the place of the mesh in the arena of its vertex layout, draws pass it as index offset and base vertex
+    GeometryArena       *arena;
+    ArenaRange           range;
+
+    // the arena VAO, shared with every mesh of the same vertex layout
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
+    // constructor, only keeps the data so meshes can be built on worker threads; upload() creates the GL objects
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : uvDensity(0.0f), compact(false), positionOffset(0.0f), positionScale(1.0f), indexType(GL_UNSIGNED_INT), arena(nullptr), range(), VAO(0)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+    // copies the vertices and indices into the arena of the vertex layout, must run on the thread owning the GL
+    // context. compactVertices stores the vertices as PackedVertex on the GPU, the float data stays available on the CPU
+    void upload(bool compactVertices = false)
+    {
+        if (arena)
+            return;
+        compact = compactVertices;
         setupMesh();
     }
 
+    // uniforms the vertex shaders need to decode the vertex layout of this mesh, their handles are looked up once per
+    // shader like the samplers of a Material
+    void setVertexDecode(const Shader &shader) const
+    {
+        const DecodeBinding &binding = decodeBindingFor(shader);
+        binding.positionOffset.set(positionOffset);
+        binding.positionScale.set(positionScale);
+        binding.compactVertices.set(compact ? 1 : 0);
+    }
+
+    // gives the space of the mesh back to its arena, the CPU side data stays
+    void release()
+    {
+        if (!arena)
+            return;
+        arena->free(range);
+        arena = nullptr;
+        VAO = 0;
+    }
+
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
+        material.bind(shader);
+        setVertexDecode(shader);
 
+        // draw mesh, the VAO and texture units are left bound so the next draw can skip identical binds
+        GLState::get().bindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void*)range.indexOffset, range.baseVertex);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // render instanceCount copies of the mesh, vao is an arena VAO with the instance attributes set up
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, unsigned int vao)
+    {
+        material.bind(shader);
+        setVertexDecode(shader);
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        GLState::get().bindVertexArray(vao);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void*)range.indexOffset, instanceCount,
+                                          range.baseVertex);
     }
 
 private:
-    // render data
-    unsigned int VBO, EBO;
+    // vertex decode handles of one shader
+    struct DecodeBinding {
+        unsigned int program;
+        Uniform<glm::vec3> positionOffset;
+        Uniform<glm::vec3> positionScale;
+        Uniform<int> compactVertices;
+    };
+
+    mutable std::vector<DecodeBinding> decodeBindings;
 
-    // initializes all the buffer objects/arrays
+    const DecodeBinding& decodeBindingFor(const Shader &shader) const
+    {
+        for (unsigned int i = 0; i < decodeBindings.size(); i++)
+            if (decodeBindings[i].program == shader.ID)
+                return decodeBindings[i];
+
+        DecodeBinding binding;
+        binding.program = shader.ID;
+        binding.positionOffset = shader.getUniform<glm::vec3>("positionOffset");
+        binding.positionScale = shader.getUniform<glm::vec3>("positionScale");
+        binding.compactVertices = shader.getUniform<int>("compactVertices");
+        decodeBindings.push_back(binding);
+        return decodeBindings.back();
+    }
+
+    // packs the vertices for the chosen layout and copies them and the indices into the arena
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        // 16 bit indices when the vertex count allows it, halving the index memory
+        vector<unsigned short> shortIndices;
+        const void *indexData = indices.empty() ? nullptr : &indices[0];
+        size_t indexBytes = indices.size() * sizeof(unsigned int);
+        indexType = GL_UNSIGNED_INT;
+        if (vertices.size() <= 65536)
+        {
+            indexType = GL_UNSIGNED_SHORT;
+            shortIndices.assign(indices.begin(), indices.end());
+            indexData = shortIndices.empty() ? nullptr : &shortIndices[0];
+            indexBytes = shortIndices.size() * sizeof(unsigned short);
+        }
+
+        arena = &meshArena(compact);
+        if (compact)
+        {
+            vector<PackedVertex> packed = packVertices();
+            range = arena->allocate(packed.empty() ? nullptr : &packed[0], packed.size(), indexData, indexBytes);
+        }
+        else
+        {
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            range = arena->allocate(vertices.empty() ? nullptr : &vertices[0], vertices.size(), indexData, indexBytes);
+        }
+        VAO = arena->getVertexArray();
+    }
+
+    // the vertices converted to PackedVertex, positions are quantized to the bounding box
+    vector<PackedVertex> packVertices()
+    {
+        positionOffset = boundingBox.min;
+        positionScale = boundingBox.max - boundingBox.min;
+
+        vector<PackedVertex> packed(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            PackedVertex &target = packed[i];
+            for (unsigned int axis = 0; axis < 3; axis++)
+                target.position[axis] = quantizeUnorm16(vertex.Position[axis], positionOffset[axis], positionScale[axis]);
+
+            glm::vec2 tangent = octahedralEncode(vertex.Tangent);
+            target.tangent[0] = (int8_t)packSnorm(tangent.x, 127.0f);
+            target.tangent[1] = (int8_t)packSnorm(tangent.y, 127.0f);
+
+            // the bitangent is rebuilt as cross(normal, tangent) * handedness
+            float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+            target.normal = packSnorm1010102(vertex.Normal, handedness);
+
+            target.texCoords[0] = packHalf(vertex.TexCoords.x);
+            target.texCoords[1] = packHalf(vertex.TexCoords.y);
+        }
+        return packed;
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,307 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read only mapping of a whole file, unmapped with the object
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), length(0) {}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string &path)
+    {
+        close();
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (mapped != MAP_FAILED)
+            {
+                data = (const unsigned char*)mapped;
+                length = info.st_size;
+            }
+        }
+        ::close(file);
+        return data != nullptr;
+    }
+
+    void close()
+    {
+        if (data)
+            munmap((void*)data, length);
+        data = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* getData() const
+    {
+        return data;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    const unsigned char *data;
+    size_t length;
+};
+
+// Binary copy of what Model::processMesh builds from a model file, so later runs can skip Assimp. The cache file
+// lives next to the model as "<file>.meshcache" and is only used while the size and modification time of the model
+// file, the import flags, the format version and the Vertex layout all match what it was written with.
+//
+// Layout, all little endian and 4 byte aligned:
+//   Header
+//   textureCount x { uint32 pathLength, path bytes padded to 4 }
+//   meshCount x { MeshHeader, textureCount x TextureRef, vertexCount x Vertex, indexCount x uint32 }
+class MeshCache {
+public:
+    // 2: meshes are stored after the mesh optimizer ran, 3: with welded vertices, 4: with the texture coordinate density
+    static const uint32_t VERSION = 4;
+
+    static std::string cachePath(const std::string &source)
+    {
+        return source + ".meshcache";
+    }
+
+    // fills meshes and textures (ids 0) from the cache of source, returns false if there is no valid cache
+    static bool read(const std::string &source, unsigned int importFlags, vector<Mesh> &meshes, vector<Texture> &textures)
+    {
+        SourceInfo info;
+        if (!sourceInfo(source, info))
+            return false;
+        MappedFile file;
+        if (!file.open(cachePath(source)))
+            return false;
+
+        Reader reader(file.getData(), file.size());
+        const Header *header = reader.take<Header>(1);
+        if (!header || header->magic != MAGIC || header->version != VERSION ||
+            header->vertexSize != sizeof(Vertex) || header->importFlags != importFlags ||
+            header->sourceSize != info.size || header->sourceTime != info.time)
+            return false;
+
+        vector<Texture> readTextures;
+        for (uint32_t i = 0; i < header->textureCount; i++)
+        {
+            const uint32_t *length = reader.take<uint32_t>(1);
+            const char *path = length ? reader.take<char>(padded(*length)) : nullptr;
+            if (!path)
+                return false;
+            Texture texture;
+            texture.id = 0;
+            texture.layer = 0;
+            texture.type = TEXTURE_DIFFUSE;
+            texture.path.assign(path, *length);
+            texture.hash = 0;
+            readTextures.push_back(texture);
+        }
+
+        vector<Mesh> readMeshes;
+        readMeshes.reserve(header->meshCount);
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshHeader *mesh = reader.take<MeshHeader>(1);
+            if (!mesh)
+                return false;
+            const TextureRef *refs = reader.take<TextureRef>(mesh->textureCount);
+            const Vertex *vertices = reader.take<Vertex>(mesh->vertexCount);
+            const uint32_t *indices = reader.take<uint32_t>(mesh->indexCount);
+            if ((mesh->textureCount && !refs) || (mesh->vertexCount && !vertices) || (mesh->indexCount && !indices))
+                return false;
+
+            vector<Texture> meshTextures;
+            for (uint32_t j = 0; j < mesh->textureCount; j++)
+            {
+                if (refs[j].index >= readTextures.size() || refs[j].type >= TEXTURE_TYPE_COUNT)
+                    return false;
+                Texture texture = readTextures[refs[j].index];
+                texture.type = (TextureType)refs[j].type;
+                meshTextures.push_back(texture);
+            }
+
+            // one copy straight out of the page cache, no parsing
+            readMeshes.push_back(Mesh(vector<Vertex>(vertices, vertices + mesh->vertexCount),
+                                      vector<unsigned int>(indices, indices + mesh->indexCount), meshTextures));
+            readMeshes.back().boundingBox = mesh->box;
+            readMeshes.back().boundingSphere = mesh->sphere;
+            readMeshes.back().uvDensity = mesh->uvDensity;
+        }
+
+        meshes.swap(readMeshes);
+        textures.swap(readTextures);
+        return true;
+    }
+
+    // writes the cache of source, textures lists every path the meshes reference once. Failures only cost the
+    // next start another import
+    static void write(const std::string &source, unsigned int importFlags, const vector<Mesh> &meshes, const vector<Texture> &textures)
+    {
+        SourceInfo info;
+        if (!sourceInfo(source, info))
+            return;
+
+        // written under a name of its own and renamed, so concurrent imports and readers never see half a file
+        std::string path = cachePath(source);
+        std::string temporary = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file)
+            return;
+
+        Header header;
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = importFlags;
+        header.textureCount = textures.size();
+        header.meshCount = meshes.size();
+        header.sourceSize = info.size;
+        header.sourceTime = info.time;
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        for (unsigned int i = 0; i < textures.size() && ok; i++)
+        {
+            uint32_t length = textures[i].path.size();
+            std::string bytes = textures[i].path;
+            bytes.resize(padded(length), '\0');
+            ok = fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        }
+
+        for (unsigned int i = 0; i < meshes.size() && ok; i++)
+        {
+            const Mesh &mesh = meshes[i];
+            MeshHeader meshHeader;
+            meshHeader.vertexCount = mesh.vertices.size();
+            meshHeader.indexCount = mesh.indices.size();
+            meshHeader.textureCount = mesh.textures.size();
+            meshHeader.box = mesh.boundingBox;
+            meshHeader.sphere = mesh.boundingSphere;
+            meshHeader.uvDensity = mesh.uvDensity;
+            ok = fwrite(&meshHeader, sizeof(meshHeader), 1, file) == 1;
+
+            for (unsigned int j = 0; j < mesh.textures.size() && ok; j++)
+            {
+                TextureRef ref;
+                ref.index = textures.size();
+                for (unsigned int k = 0; k < textures.size(); k++)
+                    if (textures[k].path == mesh.textures[j].path)
+                        ref.index = k;
+                ref.type = mesh.textures[j].type;
+                ok = fwrite(&ref, sizeof(ref), 1, file) == 1;
+            }
+            if (ok && !mesh.vertices.empty())
+                ok = fwrite(&mesh.vertices[0], sizeof(Vertex), mesh.vertices.size(), file) == mesh.vertices.size();
+            if (ok && !mesh.indices.empty())
+                ok = fwrite(&mesh.indices[0], sizeof(unsigned int), mesh.indices.size(), file) == mesh.indices.size();
+        }
+
+        ok = fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            std::cout << "ERROR::MESH_CACHE::WRITE_FAILED " << path << std::endl;
+        }
+    }
+
+private:
+    // "MSHC" read as a little endian integer
+    static const uint32_t MAGIC = 0x4348534D;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t importFlags;
+        uint32_t textureCount;
+        uint32_t meshCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct MeshHeader {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        BoundingBox box;
+        BoundingSphere sphere;
+        float uvDensity;
+    };
+
+    struct TextureRef {
+        uint32_t index;
+        uint32_t type;
+    };
+
+    struct SourceInfo {
+        uint64_t size;
+        // modification time in nanoseconds
+        int64_t time;
+    };
+
+    // hands out consecutive arrays of the mapping, null once the file is too short
+    class Reader {
+    public:
+        Reader(const unsigned char *data, size_t size) : data(data), size(size), offset(0) {}
+
+        template<typename T>
+        const T* take(size_t count)
+        {
+            size_t bytes = (count * sizeof(T) + 3) & ~(size_t)3;
+            if (count > size / sizeof(T) || bytes > size - offset)
+                return nullptr;
+            const T *result = (const T*)(data + offset);
+            offset += bytes;
+            return result;
+        }
+
+    private:
+        const unsigned char *data;
+        size_t size;
+        size_t offset;
+    };
+
+    static uint32_t padded(uint32_t length)
+    {
+        return (length + 3) & ~3u;
+    }
+
+    static bool sourceInfo(const std::string &source, SourceInfo &info)
+    {
+        struct stat status;
+        if (stat(source.c_str(), &status) != 0)
+            return false;
+        info.size = status.st_size;
+        info.time = (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+        return true;
+    }
+};
+
+#endif
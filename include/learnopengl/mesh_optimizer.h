@@ -0,0 +1,289 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+// Load time reordering of indexed triangle lists for the GPU, after duplicate vertices were welded:
+//   1. vertex cache: Tipsify (Sander, Nehab, Barczak 2007) orders the triangles so the post transform cache hits
+//   2. overdraw: the clusters Tipsify leaves at its hard boundaries are sorted so outward facing ones draw first
+//   3. vertex fetch: vertices are renumbered in the order the index buffer first uses them
+// Everything works on plain index/vertex arrays and doesn't touch GL, so it runs on the import threads.
+
+// transformed vertices per triangle (ACMR) and per referenced vertex (ATVR) for a FIFO cache, 1.0 ATVR is ideal
+struct VertexCacheStats {
+    float acmr;
+    float atvr;
+};
+
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                           unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    stats.acmr = stats.atvr = 0.0f;
+    if (indices.empty())
+        return stats;
+
+    // a vertex is cached while fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> loadedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int misses = 0;
+    unsigned int unique = 0;
+    for (unsigned int i = 0; i < indices.size(); i++)
+    {
+        unsigned int vertex = indices[i];
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            unique++;
+        }
+        if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] >= cacheSize)
+        {
+            misses++;
+            loadedAt[vertex] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / unique;
+    return stats;
+}
+
+// Tipsify, returns the triangle order in indices and the first triangle of every cluster in clusters
+inline void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount, std::vector<unsigned int> &clusters,
+                                unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    clusters.clear();
+    unsigned int triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles around every vertex
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int i = 0; i < triangleCount * 3; i++)
+        offsets[indices[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<unsigned int> live(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = indices[0];
+    clusters.push_back(0);
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // the candidate that stays in the cache longest while its remaining triangles are emitted
+        int best = -1;
+        unsigned int bestPriority = 0;
+        for (unsigned int c = 0; c < candidates.size(); c++)
+        {
+            unsigned int v = candidates[c];
+            if (live[v] == 0)
+                continue;
+            unsigned int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (best < 0 || priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+        if (best >= 0)
+        {
+            fanning = best;
+            continue;
+        }
+
+        // dead end: the most recently used vertex with triangles left, otherwise the next one in input order. Both
+        // leave the cache mostly cold, so the triangles from here on can move as a cluster in the overdraw sort
+        fanning = -1;
+        while (!deadEnd.empty() && fanning < 0)
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+        if (fanning >= 0)
+        {
+            clusters.push_back(result.size() / 3);
+            continue;
+        }
+
+        while (cursor < vertexCount && live[cursor] == 0)
+            cursor++;
+        if (cursor < vertexCount)
+        {
+            fanning = cursor;
+            clusters.push_back(result.size() / 3);
+        }
+    }
+    indices.swap(result);
+}
+
+// sorts the clusters so the ones facing away from the mesh center, which tend to occlude the rest, draw first.
+// position(i) returns the position of vertex i
+template<typename PositionOf>
+void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<unsigned int> &clusters, PositionOf position)
+{
+    unsigned int triangleCount = indices.size() / 3;
+    if (clusters.size() < 2)
+        return;
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    struct Cluster {
+        unsigned int begin, end;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted(clusters.size());
+    std::vector<glm::vec3> centers(clusters.size());
+    std::vector<glm::vec3> normals(clusters.size());
+
+    for (unsigned int c = 0; c < clusters.size(); c++)
+    {
+        sorted[c].begin = clusters[c];
+        sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = sorted[c].begin; t < sorted[c].end; t++)
+        {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), e = position(indices[t * 3 + 2]);
+            glm::vec3 cross = glm::cross(b - a, e - a);
+            float triangleArea = glm::length(cross);
+            center += (a + b + e) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        centers[c] = area > 0.0f ? center / area : position(indices[sorted[c].begin * 3]);
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        meshCenter += center;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    for (unsigned int c = 0; c < sorted.size(); c++)
+        sorted[c].sortKey = glm::dot(centers[c] - meshCenter, normals[c]);
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (unsigned int c = 0; c < sorted.size(); c++)
+        result.insert(result.end(), indices.begin() + sorted[c].begin * 3, indices.begin() + sorted[c].end * 3);
+    indices.swap(result);
+}
+
+// merges vertices whose attributes are bitwise identical and points the indices at the survivors, which keep their
+// first occurrence order. OBJ files index positions, normals and UVs separately, so Assimp emits one vertex per face
+// corner and most of them are duplicates.
+template<typename VertexType>
+void weldVertices(std::vector<unsigned int> &indices, std::vector<VertexType> &vertices)
+{
+    static_assert(std::is_trivially_copyable<VertexType>::value, "vertices are compared bytewise");
+    struct Hash {
+        const std::vector<VertexType> *vertices;
+        size_t operator()(unsigned int index) const
+        {
+            // FNV-1a over the whole attribute tuple
+            const unsigned char *bytes = (const unsigned char*)&(*vertices)[index];
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (size_t i = 0; i < sizeof(VertexType); i++)
+                hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+            return (size_t)hash;
+        }
+    };
+    struct Equal {
+        const std::vector<VertexType> *vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return std::memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(VertexType)) == 0;
+        }
+    };
+
+    // the set holds indices into welded, which grows as unique vertices are found
+    std::vector<VertexType> welded;
+    welded.reserve(vertices.size());
+    Hash hash = {&welded};
+    Equal equal = {&welded};
+    std::unordered_set<unsigned int, Hash, Equal> unique(vertices.size(), hash, equal);
+
+    std::vector<unsigned int> remap(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        welded.push_back(vertices[i]);
+        std::pair<typename std::unordered_set<unsigned int, Hash, Equal>::iterator, bool> inserted = unique.insert(welded.size() - 1);
+        if (!inserted.second)
+            welded.pop_back();
+        remap[i] = *inserted.first;
+    }
+    for (unsigned int i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+    vertices.swap(welded);
+}
+
+// renumbers the vertices in first use order and reorders vertices to match, unreferenced vertices are dropped
+template<typename VertexType>
+void optimizeVertexFetch(std::vector<unsigned int> &indices, std::vector<VertexType> &vertices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<VertexType> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int i = 0; i < indices.size(); i++)
+    {
+        unsigned int &target = remap[indices[i]];
+        if (target == unused)
+        {
+            target = reordered.size();
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+    vertices.swap(reordered);
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// CPU mip chains for 8 bit images, built where the image was decoded so the main thread only uploads finished levels
+// instead of stalling in glGenerateMipmap.
+//
+// Every level is a 2x2 box filter of the one above with GL's rounded down sizes, so an odd last row or column is left
+// out; only a side that is down to one texel is averaged with itself. Colour images are stored sRGB encoded, so their
+// colour channels are averaged in linear light and encoded again, which keeps bright details from darkening in the
+// distance; alpha and data channels are averaged as they are. The row sums run four floats per SSE2 instruction.
+
+// what an image holds, by the file name conventions of the scene's texture sets
+enum TextureContent {
+    // diffuse and specular maps
+    CONTENT_COLOR,
+    // tangent space normal maps, "_nor" or "_normal"
+    CONTENT_NORMAL,
+    // height and displacement maps, "_disp" or "_height"
+    CONTENT_HEIGHT
+};
+
+enum MipFilter {
+    // every channel as it is
+    MIP_FILTER_LINEAR,
+    // the first three channels in linear light
+    MIP_FILTER_SRGB,
+    // like linear, then the first three channels are scaled back to a unit vector
+    MIP_FILTER_NORMAL
+};
+
+inline TextureContent textureContentFromName(const std::string &path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (name.find("_nor") != std::string::npos || name.find("_normal") != std::string::npos)
+        return CONTENT_NORMAL;
+    if (name.find("_disp") != std::string::npos || name.find("_height") != std::string::npos)
+        return CONTENT_HEIGHT;
+    return CONTENT_COLOR;
+}
+
+// images with fewer than three channels are masks or data and filtered linearly
+inline MipFilter mipFilterFor(TextureContent content, int components)
+{
+    if (components < 3 || content == CONTENT_HEIGHT)
+        return MIP_FILTER_LINEAR;
+    return content == CONTENT_NORMAL ? MIP_FILTER_NORMAL : MIP_FILTER_SRGB;
+}
+
+// levels of a full chain down to 1x1, the base level included
+inline int mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        levels++;
+    return levels;
+}
+
+// linear light in steps of 1 / (LINEAR_TO_SRGB_STEPS - 1) is encoded by table, off by at most one near black
+const int LINEAR_TO_SRGB_STEPS = 4096;
+
+struct SrgbTables {
+    // sRGB encoded byte to linear light
+    float toLinear[256];
+    unsigned char toSrgb[LINEAR_TO_SRGB_STEPS];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float value = i / 255.0f;
+            toLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < LINEAR_TO_SRGB_STEPS; i++)
+        {
+            float value = i / (float)(LINEAR_TO_SRGB_STEPS - 1);
+            float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = (unsigned char)std::min(std::max(encoded * 255.0f + 0.5f, 0.0f), 255.0f);
+        }
+    }
+};
+
+// built once, by whichever thread gets here first
+inline const SrgbTables& srgbTables()
+{
+    static SrgbTables tables;
+    return tables;
+}
+
+// adds two rows of count floats into sum
+inline void addRows(const float *a, const float *b, float *sum, int count)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+#endif
+    for (; i < count; i++)
+        sum[i] = a[i] + b[i];
+}
+
+// halves an image with components channels per texel into result
+inline void downsampleMip(const unsigned char *image, int width, int height, int components, MipFilter filter,
+                          std::vector<unsigned char> &result)
+{
+    int halfWidth = std::max(width / 2, 1), halfHeight = std::max(height / 2, 1);
+    result.resize((size_t)halfWidth * halfHeight * components);
+
+    const SrgbTables &tables = srgbTables();
+    bool gamma[4] = {false, false, false, false};
+    for (int c = 0; c < std::min(components, 3); c++)
+        gamma[c] = filter == MIP_FILTER_SRGB;
+
+    // the two source rows of an output row in [0, 1] and their sum
+    int rowFloats = width * components;
+    std::vector<float> top(rowFloats), bottom(rowFloats), sum(rowFloats);
+    for (int y = 0; y < halfHeight; y++)
+    {
+        const unsigned char *rows[2] = {image + (size_t)std::min(2 * y, height - 1) * rowFloats,
+                                        image + (size_t)std::min(2 * y + 1, height - 1) * rowFloats};
+        float *linear[2] = {&top[0], &bottom[0]};
+        for (int r = 0; r < 2; r++)
+            for (int x = 0; x < width; x++)
+                for (int c = 0; c < components; c++)
+                {
+                    unsigned char value = rows[r][x * components + c];
+                    linear[r][x * components + c] = gamma[c] ? tables.toLinear[value] : value / 255.0f;
+                }
+        addRows(&top[0], &bottom[0], &sum[0], rowFloats);
+
+        unsigned char *target = &result[(size_t)y * halfWidth * components];
+        for (int x = 0; x < halfWidth; x++)
+        {
+            const float *left = &sum[std::min(2 * x, width - 1) * components];
+            const float *right = &sum[std::min(2 * x + 1, width - 1) * components];
+            float texel[4];
+#ifdef __SSE2__
+            if (components == 4)
+                _mm_storeu_ps(texel, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(left), _mm_loadu_ps(right)), _mm_set1_ps(0.25f)));
+            else
+#endif
+                for (int c = 0; c < components; c++)
+                    texel[c] = (left[c] + right[c]) * 0.25f;
+
+            if (filter == MIP_FILTER_NORMAL)
+            {
+                float length = 0.0f;
+                for (int c = 0; c < 3; c++)
+                {
+                    texel[c] = texel[c] * 2.0f - 1.0f;
+                    length += texel[c] * texel[c];
+                }
+                length = std::sqrt(length);
+                for (int c = 0; c < 3; c++)
+                    texel[c] = ((length > 0.0f ? texel[c] / length : texel[c]) + 1.0f) * 0.5f;
+            }
+
+            for (int c = 0; c < components; c++)
+            {
+                float value = std::min(std::max(texel[c], 0.0f), 1.0f);
+                target[x * components + c] = gamma[c] ? tables.toSrgb[(int)(value * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)]
+                                                      : (unsigned char)(value * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+// levels[i] becomes level i + 1 of the image, down to 1x1
+inline void buildMipChain(const unsigned char *image, int width, int height, int components, MipFilter filter,
+                          std::vector<std::vector<unsigned char> > &levels)
+{
+    levels.resize(mipLevelCount(width, height) - 1);
+    const unsigned char *source = image;
+    for (unsigned int i = 0; i < levels.size(); i++)
+    {
+        downsampleMip(source, width, height, components, filter, levels[i]);
+        source = &levels[i][0];
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+#endif
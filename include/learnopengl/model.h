@@ -11,17 +11,34 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
 #include <learnopengl/shader.h>
-
+#include <learnopengl/render_queue.h>
+#include <learnopengl/texture_array.h>
+#include <learnopengl/texture_atlas.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, uint64_t contentHash = 0);
+class Model;
+inline void BakeTextureAtlas(Model **models, unsigned int count);
+
+// Assimp post processing every scene model is imported with
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
 
 
@@ -29,15 +46,66 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture file and atlas page the model references once, ids are 0 until Upload() got a layer from the TextureArrayPacker
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // model space bounds of all meshes together
+    BoundingBox boundingBox;
+    BoundingSphere boundingSphere;
+
+    // empty model, filled by Import() and Upload() or by ImportModels()
+    Model() : gammaCorrection(false), instanceVBO(0), instanceVAO(0), instanceCapacity(0), instanceCount(0) {}
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false) : gammaCorrection(gamma), instanceVBO(0), instanceVAO(0), instanceCapacity(0), instanceCount(0)
+    {
+        Import(path, TextureLoader::get().getFlipVertically());
+        Model *self = this;
+        BakeTextureAtlas(&self, 1);
+        Upload();
+        TextureArrayPacker::get().commit();
+    }
+
+    // CPU half of loading: reads the file, builds the vertex/index data and bounds of every mesh and starts decoding
+    // the textures; the ones that can go into a texture atlas are decoded right away for BakeTextureAtlas(). Doesn't
+    // touch GL, so different models can be imported on worker threads at the same time.
+    bool Import(string const &path, bool flipTextures, unsigned int importFlags = MODEL_IMPORT_FLAGS)
     {
-        loadModel(path);
+        return loadModel(path, flipTextures, importFlags);
+    }
+
+    // GL half of loading, main thread only: creates the buffers of every mesh and reserves a texture array layer for
+    // every texture. The next TextureArrayPacker::commit() requests the pixels from the TextureLoader, which claims the
+    // decodes Import() started. Call once Import() and, for models with atlas images, BakeTextureAtlas() returned.
+    // compactVertices uploads the meshes with the 16 byte PackedVertex layout instead of the float Vertex
+    void Upload(bool compactVertices = false)
+    {
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            Texture &texture = textures_loaded[i];
+            TextureLayer layer;
+            if (texture.id == 0 && TextureArrayPacker::get().add(directory + '/' + texture.path, WRAP_REPEAT, texture.hash, layer))
+            {
+                texture.id = layer.texture;
+                texture.layer = layer.layer;
+            }
+        }
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            mesh.upload(compactVertices);
+            mesh.material = Material();
+            for(unsigned int j = 0; j < mesh.textures.size(); j++)
+            {
+                Texture &texture = mesh.textures[j];
+                const Texture &loaded = textures_loaded[textureIndices[texture.path]];
+                texture.id = loaded.id;
+                texture.layer = loaded.layer;
+                mesh.material.add(texture.id, texture.type, GL_TEXTURE_2D_ARRAY, texture.layer);
+            }
+        }
     }
 
     // draws the model, and thus all its meshes
@@ -47,29 +115,353 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // submits one draw per mesh to the render queue instead of drawing right away, meshes outside the frustum are skipped
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const RenderState &state = RenderState(),
+                RenderPass pass = PASS_OPAQUE)
+    {
+        DrawCommand command;
+        command.pass = pass;
+        command.shader = &shader;
+        command.indexed = true;
+        command.hasModel = true;
+        command.model = model;
+        command.state = state;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            command.material = &meshes[i].material;
+            command.vao = meshes[i].VAO;
+            command.count = meshes[i].indices.size();
+            command.indexType = meshes[i].indexType;
+            command.indexOffset = meshes[i].range.indexOffset;
+            command.baseVertex = meshes[i].range.baseVertex;
+            command.compactVertices = meshes[i].compact;
+            command.positionOffset = meshes[i].positionOffset;
+            command.positionScale = meshes[i].positionScale;
+            command.uvDensity = meshes[i].uvDensity;
+            queue.submit(command, meshes[i].boundingSphere);
+        }
+    }
+
+    // uploads one model matrix per instance into the instance buffer shared by all meshes of the model
+    void SetInstanceTransforms(const glm::mat4 *transforms, unsigned int count)
+    {
+        if (instanceVBO == 0)
+        {
+            glGenBuffers(1, &instanceVBO);
+            // all meshes of the model share one arena, a VAO of their own adds the instance attributes to it
+            if (!meshes.empty() && meshes[0].arena)
+            {
+                instanceVAO = meshes[0].arena->createVertexArray();
+                setupInstanceAttributes(instanceVAO, instanceVBO);
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (count > instanceCapacity)
+        {
+            glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), transforms, GL_DYNAMIC_DRAW);
+            instanceCapacity = count;
+        }
+        else if (count > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+        instanceCount = count;
+    }
+
+    // draws every instance set by SetInstanceTransforms, one instanced draw call per mesh
+    void DrawInstanced(Shader &shader)
+    {
+        if (instanceCount == 0)
+            return;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceCount, instanceVAO);
+    }
+
+    // queued counterpart of DrawInstanced, the per-instance matrices come from the instance buffer
+    void SubmitInstanced(RenderQueue &queue, Shader &shader, const RenderState &state = RenderState())
+    {
+        if (instanceCount == 0)
+            return;
+
+        DrawCommand command;
+        command.shader = &shader;
+        command.indexed = true;
+        command.instanceCount = instanceCount;
+        command.state = state;
+        command.vao = instanceVAO;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            command.material = &meshes[i].material;
+            command.count = meshes[i].indices.size();
+            command.indexType = meshes[i].indexType;
+            command.indexOffset = meshes[i].range.indexOffset;
+            command.baseVertex = meshes[i].range.baseVertex;
+            command.compactVertices = meshes[i].compact;
+            command.positionOffset = meshes[i].positionOffset;
+            command.positionScale = meshes[i].positionScale;
+            queue.submit(command);
+        }
+    }
+
+    // frees the geometry and textures of the model, needs the GL context, so it is called before the window closes
+    void Release()
+    {
+        GLState &state = GLState::get();
+        state.invalidate();
+        if (instanceVAO && !meshes.empty() && meshes[0].arena)
+            meshes[0].arena->destroyVertexArray(instanceVAO);
+        instanceVAO = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].release();
+        if (instanceVBO)
+        {
+            glDeleteBuffers(1, &instanceVBO);
+            instanceVBO = 0;
+            instanceCapacity = instanceCount = 0;
+        }
+        // layers can be shared with other models, the packer frees them with their last user
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if (textures_loaded[i].id == 0)
+                continue;
+            TextureLayer layer = {textures_loaded[i].id, textures_loaded[i].layer};
+            TextureArrayPacker::get().release(layer);
+            textures_loaded[i].id = 0;
+        }
+    }
+
+    // whether Import() left images for BakeTextureAtlas()
+    bool HasAtlasImages() const
+    {
+        return !atlasTextures.empty();
+    }
+
+    // hands the decoded atlas images to the caller, in the order ApplyAtlas() expects their placements
+    void TakeAtlasImages(vector<AtlasImage> &images)
+    {
+        for(unsigned int i = 0; i < atlasImages.size(); i++)
+        {
+            images.push_back(AtlasImage());
+            images.back().width = atlasImages[i].width;
+            images.back().height = atlasImages[i].height;
+            images.back().pixels.swap(atlasImages[i].pixels);
+        }
+        atlasImages.clear();
+    }
+
+    // points the meshes using the atlas images at their place in the pages: UVs are remapped, the images are replaced
+    // by the page textures and every page the model uses gets a reference of the model. placements has one entry per
+    // image of TakeAtlasImages(), pages holds the layer of every page. Passing no pages keeps the images as they are
+    void ApplyAtlas(const AtlasPlacement *placements, const vector<TextureLayer> &pages)
+    {
+        vector<int> placementOf(textures_loaded.size(), -1);
+        for(unsigned int i = 0; i < atlasTextures.size() && !pages.empty(); i++)
+            placementOf[atlasTextures[i]] = i;
+        atlasTextures.clear();
+        atlasImages.clear();
+        if (pages.empty())
+            return;
+
+        vector<int> pageTexture(pages.size(), -1);
+        vector<Texture> remaining;
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            if (placementOf[i] < 0)
+                remaining.push_back(textures_loaded[i]);
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if (mesh.textures.empty() || placementOf[textureIndices[mesh.textures[0].path]] < 0)
+                continue;
+            const AtlasPlacement &placement = placements[placementOf[textureIndices[mesh.textures[0].path]]];
+            for(unsigned int v = 0; v < mesh.vertices.size(); v++)
+            {
+                glm::vec2 &uv = mesh.vertices[v].TexCoords;
+                uv = placement.offset + glm::clamp(uv, 0.0f, 1.0f) * placement.scale;
+            }
+            // the image covers only part of the page, its texels get smaller in page UVs alike
+            mesh.uvDensity *= std::sqrt(placement.scale.x * placement.scale.y);
+
+            if (pageTexture[placement.page] < 0)
+            {
+                Texture page;
+                page.id = pages[placement.page].texture;
+                page.layer = pages[placement.page].layer;
+                page.type = TEXTURE_DIFFUSE;
+                page.path = "<atlas " + to_string(placement.page) + ">";
+                page.hash = 0;
+                TextureArrayPacker::get().retain(pages[placement.page]);
+                pageTexture[placement.page] = remaining.size();
+                remaining.push_back(page);
+            }
+            // meshes that qualify sample a single image, possibly as several types
+            for(unsigned int j = 0; j < mesh.textures.size(); j++)
+                mesh.textures[j].path = remaining[pageTexture[placement.page]].path;
+        }
+
+        textures_loaded.swap(remaining);
+        textureIndices.clear();
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            textureIndices[textures_loaded[i].path] = i;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.material.setPrefix(prefix);
         }
     }
 private:
+    // per-instance model matrices used by DrawInstanced, sourced by a VAO of the model over its arena
+    unsigned int instanceVBO;
+    unsigned int instanceVAO;
+    unsigned int instanceCapacity;
+    unsigned int instanceCount;
+    // position of every texture path in textures_loaded
+    unordered_map<string, unsigned int> textureIndices;
+    // textures_loaded entries that qualify for the atlas and their decoded pixels, until BakeTextureAtlas()
+    vector<unsigned int> atlasTextures;
+    vector<AtlasImage> atlasImages;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // a valid MeshCache file of path is used instead of Assimp, a fresh import writes one.
+    bool loadModel(string const &path, bool flipTextures, unsigned int importFlags)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
-        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        if (MeshCache::read(path, importFlags, meshes, textures_loaded))
+        {
+            textureIndices.clear();
+            for(unsigned int i = 0; i < textures_loaded.size(); i++)
+                textureIndices[textures_loaded[i].path] = i;
+        }
+        else
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, importFlags);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene);
+            optimizeMeshes(path);
+            MeshCache::write(path, importFlags, meshes, textures_loaded);
+        }
+        computeModelBounds();
+        collectAtlasImages(flipTextures);
+
+        // the decodes run on the TextureLoader pool while the rest of the scene keeps importing, the hashes let the
+        // TextureArrayPacker recognize images other models already loaded without reading the files on the main thread
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if (std::find(atlasTextures.begin(), atlasTextures.end(), i) != atlasTextures.end())
+                continue;
+            string file = directory + '/' + textures_loaded[i].path;
+            textures_loaded[i].hash = TextureRegistry::hashFile(file);
+            TextureLoader::get().prefetch(file, flipTextures);
+        }
+        return true;
+    }
+
+    // welds duplicate vertices, then reorders the index and vertex buffers of every mesh for the vertex cache,
+    // overdraw and vertex fetch and reports the vertex count and the transformed vertices per triangle (ACMR) and per
+    // vertex (ATVR) before and after
+    void optimizeMeshes(string const &path)
+    {
+        ostringstream report;
+        report.precision(3);
+        report << fixed;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+            unsigned int vertexCount = mesh.vertices.size();
+
+            weldVertices(mesh.indices, mesh.vertices);
+            vector<unsigned int> clusters;
+            optimizeVertexCache(mesh.indices, mesh.vertices.size(), clusters);
+            optimizeOverdraw(mesh.indices, clusters, [&mesh](unsigned int vertex) { return mesh.vertices[vertex].Position; });
+            optimizeVertexFetch(mesh.indices, mesh.vertices);
+
+            VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+            report << "MESH::OPTIMIZE " << path << " mesh " << i << ": vertices " << vertexCount << " -> "
+                   << mesh.vertices.size() << ", ACMR " << before.acmr << " -> " << after.acmr
+                   << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+        }
+        // a single write, the imports of other models print at the same time
+        cout << report.str() << flush;
+    }
+
+    // Decodes the textures that can move into a texture atlas, see buildAtlas. A texture qualifies when it is at most
+    // ATLAS_MAX_IMAGE_SIZE texels large and every mesh using it samples no other image and keeps its UVs inside it
+    // (up to ATLAS_UV_TOLERANCE); textures that repeat can't be cut out of a page. Runs after the MeshCache, which
+    // keeps the original UVs
+    void collectAtlasImages(bool flipTextures)
+    {
+        atlasTextures.clear();
+        atlasImages.clear();
+
+        vector<bool> qualifies(textures_loaded.size(), false);
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            int width, height, components;
+            string file = directory + '/' + textures_loaded[i].path;
+            qualifies[i] = stbi_info(file.c_str(), &width, &height, &components) && std::max(width, height) <= ATLAS_MAX_IMAGE_SIZE;
+        }
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            bool single = true;
+            for(unsigned int j = 1; j < mesh.textures.size(); j++)
+                single = single && mesh.textures[j].path == mesh.textures[0].path;
+            bool inside = true;
+            for(unsigned int v = 0; v < mesh.vertices.size() && inside; v++)
+            {
+                glm::vec2 uv = mesh.vertices[v].TexCoords;
+                inside = uv.x >= -ATLAS_UV_TOLERANCE && uv.y >= -ATLAS_UV_TOLERANCE &&
+                         uv.x <= 1.0f + ATLAS_UV_TOLERANCE && uv.y <= 1.0f + ATLAS_UV_TOLERANCE;
+            }
+            if (!single || !inside)
+                for(unsigned int j = 0; j < mesh.textures.size(); j++)
+                    qualifies[textureIndices[mesh.textures[j].path]] = false;
+        }
+
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            if (!qualifies[i])
+                continue;
+            string file = directory + '/' + textures_loaded[i].path;
+            AtlasImage image;
+            int components;
+            unsigned char *data = stbi_load(file.c_str(), &image.width, &image.height, &components, 4);
+            if (!data)
+                continue;
+            if (flipTextures)
+                TextureLoader::flipRows(data, image.width, image.height, 4);
+            image.pixels.assign(data, data + (size_t)image.width * image.height * 4);
+            stbi_image_free(data);
+            atlasImages.push_back(image);
+            atlasTextures.push_back(i);
+        }
+    }
+
+    void computeModelBounds()
+    {
+        boundingBox.min = boundingBox.max = glm::vec3(0.0f);
+        vector<BoundingSphere> spheres;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const BoundingBox &box = meshes[i].boundingBox;
+            boundingBox.min = i == 0 ? box.min : glm::min(boundingBox.min, box.min);
+            boundingBox.max = i == 0 ? box.max : glm::max(boundingBox.max, box.max);
+            spheres.push_back(meshes[i].boundingSphere);
+        }
+        boundingSphere = mergeBounds(boundingBox, spheres.empty() ? nullptr : &spheres[0], spheres.size());
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -96,7 +488,6 @@ private:
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -164,96 +555,166 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        vector<Texture> textures;
+        loadMaterialTextures(textures, material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(textures, material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(textures, material, aiTextureType_HEIGHT, TEXTURE_NORMAL);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+        loadMaterialTextures(textures, material, aiTextureType_AMBIENT, TEXTURE_HEIGHT);
 
-
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return a mesh object created from the extracted mesh data, Upload() turns the textures into its material
+        Mesh result(vertices, indices, textures);
+        if (!vertices.empty())
+        {
+            computeBounds(&vertices[0].Position.x, vertices.size(), sizeof(Vertex) / sizeof(float), result.boundingBox, result.boundingSphere);
+            if (!indices.empty())
+                result.uvDensity = computeUvDensity(&vertices[0].Position.x, &vertices[0].TexCoords.x, sizeof(Vertex) / sizeof(float),
+                                                    &indices[0], indices.size());
+        }
+        return result;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and records the ones that aren't known yet.
+    // the textures are appended to the texture list of the mesh, their ids are assigned by Upload().
+    void loadMaterialTextures(vector<Texture> &textures, aiMaterial *mat, aiTextureType type, TextureType textureType)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            Texture texture;
+            texture.id = 0;
+            texture.layer = 0;
+            texture.type = textureType;
+            texture.path = str.C_Str();
+            texture.hash = 0;
+            textures.push_back(texture);
+
+            // store every path once for the entire model, textures shared across models are merged by the TextureArrayPacker
+            if(textureIndices.find(texture.path) == textureIndices.end())
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                textureIndices[texture.path] = textures_loaded.size();
+                textures_loaded.push_back(texture);
             }
         }
-        return textures;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// gets the texture from the TextureRegistry, a new image is queued on the TextureLoader and its name is filled once
+// the loader uploads it. The returned reference is given back with TextureRegistry::release
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, uint64_t contentHash)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    return TextureRegistry::get().load2D(filename, WRAP_REPEAT, contentHash);
+}
+
+// Packs the atlas images of several imported models into shared pages (see buildAtlas) and points their meshes at
+// them, so small props of different models draw from one texture. Main thread, before the models' Upload(); fewer
+// than two images aren't worth a page and stay ordinary textures.
+inline void BakeTextureAtlas(Model **models, unsigned int count)
+{
+    vector<AtlasImage> images;
+    vector<unsigned int> firstImage;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        firstImage.push_back(images.size());
+        models[i]->TakeAtlasImages(images);
+    }
+
+    vector<AtlasPage> pages;
+    vector<AtlasPlacement> placements;
+    vector<TextureLayer> layers;
+    if (images.size() >= 2)
+    {
+        buildAtlas(images, pages, placements);
+        for(unsigned int p = 0; p < pages.size(); p++)
+        {
+            TextureLayer layer;
+            TextureArrayPacker::get().addBaked(pages[p].size, pages[p].size, pages[p].levels, layer);
+            layers.push_back(layer);
+        }
+        cout << "TEXTURE::ATLAS " << images.size() << " textures in " << pages.size() << " page(s) of "
+             << pages[0].size << "x" << pages[0].size << endl;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+        models[i]->ApplyAtlas(placements.data() + firstImage[i], layers);
+    // the models hold their own references now
+    for(unsigned int p = 0; p < layers.size(); p++)
+        TextureArrayPacker::get().release(layers[p]);
+}
+
+// a model and the file it is loaded from, see ImportModels
+struct ModelImport {
+    Model *model;
+    string path;
+    unsigned int flags = MODEL_IMPORT_FLAGS;
+    // see Model::Upload
+    bool compactVertices = false;
+};
+
+// Loads several models at once: every Import() runs on its own worker thread and the calling thread, which must own
+// the GL context, uploads each model as soon as its import is done. Textures are prefetched with the TextureLoader's
+// current flip setting.
+inline void ImportModels(ModelImport *imports, unsigned int count)
+{
+    if (count == 0)
+        return;
+    bool flip = TextureLoader::get().getFlipVertically();
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    std::mutex mutex;
+    std::condition_variable imported;
+    vector<unsigned int> ready;
+    vector<unsigned int> atlased;
+
+    ThreadPool pool(std::min(count, ThreadPool::defaultThreadCount()));
+    for(unsigned int i = 0; i < count; i++)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        pool.enqueue([&, i] {
+            imports[i].model->Import(imports[i].path, flip, imports[i].flags);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.push_back(i);
+            }
+            imported.notify_one();
+        });
     }
-    else
+
+    unsigned int uploaded = 0;
+    while (uploaded < count)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        vector<unsigned int> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            imported.wait(lock, [&] { return !ready.empty(); });
+            batch.swap(ready);
+        }
+        // models with atlas images wait for the atlas of the whole batch
+        for(unsigned int i = 0; i < batch.size(); i++)
+        {
+            if (imports[batch[i]].model->HasAtlasImages())
+                atlased.push_back(batch[i]);
+            else
+                imports[batch[i]].model->Upload(imports[batch[i]].compactVertices);
+        }
+        uploaded += batch.size();
+        // upload the textures decoded meanwhile so they don't pile up in memory
+        TextureLoader::get().pump();
     }
 
-    return textureID;
+    vector<Model*> models;
+    for(unsigned int i = 0; i < atlased.size(); i++)
+        models.push_back(imports[atlased[i]].model);
+    if (!models.empty())
+        BakeTextureAtlas(&models[0], models.size());
+    for(unsigned int i = 0; i < atlased.size(); i++)
+        imports[atlased[i]].model->Upload(imports[atlased[i]].compactVertices);
+    // the arrays are sized for every model of the batch, their layers are requested once all models reserved theirs
+    TextureArrayPacker::get().commit();
 }
 #endif
@@ -0,0 +1,143 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/texture_loader.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// a model to load through ModelCache::load, model receives the shared instance
+struct ModelRequest {
+    std::shared_ptr<Model> *model;
+    std::string path;
+    unsigned int flags = MODEL_IMPORT_FLAGS;
+    // see Model::Upload
+    bool compactVertices = false;
+};
+
+// Hands out one shared Model per file, so props placed several times are imported and uploaded once and share their
+// buffers and textures. Models are keyed by the canonical path, the import flags, the vertex layout and the texture
+// flip setting; the placement of each copy is just the model matrix it is submitted with.
+//
+// The cache keeps a reference to every model it loaded. GL objects are never deleted from a destructor: collect()
+// releases models nobody else references any more and release() frees everything before the context goes away.
+class ModelCache {
+public:
+    static ModelCache& get()
+    {
+        static ModelCache cache;
+        return cache;
+    }
+
+    ModelCache(const ModelCache&) = delete;
+    ModelCache& operator=(const ModelCache&) = delete;
+
+    std::shared_ptr<Model> load(const std::string &path, unsigned int flags = MODEL_IMPORT_FLAGS, bool compactVertices = false)
+    {
+        std::shared_ptr<Model> model;
+        ModelRequest request;
+        request.model = &model;
+        request.path = path;
+        request.flags = flags;
+        request.compactVertices = compactVertices;
+        load(&request, 1);
+        return model;
+    }
+
+    // loads every requested model, the ones not cached yet are imported in parallel and requests for the same file
+    // share one import
+    void load(ModelRequest *requests, unsigned int count)
+    {
+        bool flip = TextureLoader::get().getFlipVertically();
+        std::vector<ModelImport> imports;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string key = makeKey(requests[i].path, requests[i].flags, requests[i].compactVertices, flip);
+            std::unordered_map<std::string, std::shared_ptr<Model> >::iterator it = models.find(key);
+            if (it != models.end())
+            {
+                *requests[i].model = it->second;
+                hits++;
+                continue;
+            }
+
+            std::shared_ptr<Model> model = std::make_shared<Model>();
+            models[key] = model;
+            *requests[i].model = model;
+            misses++;
+
+            ModelImport import;
+            import.model = model.get();
+            import.path = requests[i].path;
+            import.flags = requests[i].flags;
+            import.compactVertices = requests[i].compactVertices;
+            imports.push_back(import);
+        }
+
+        if (!imports.empty())
+            ImportModels(&imports[0], imports.size());
+    }
+
+    // releases the models that are only referenced by the cache, returns how many were released
+    unsigned int collect()
+    {
+        unsigned int released = 0;
+        std::unordered_map<std::string, std::shared_ptr<Model> >::iterator it = models.begin();
+        while (it != models.end())
+        {
+            if (it->second.use_count() == 1)
+            {
+                it->second->Release();
+                it = models.erase(it);
+                released++;
+            }
+            else
+                ++it;
+        }
+        return released;
+    }
+
+    // releases every model, outstanding references keep empty models
+    void release()
+    {
+        std::unordered_map<std::string, std::shared_ptr<Model> >::iterator it;
+        for (it = models.begin(); it != models.end(); ++it)
+            it->second->Release();
+        models.clear();
+    }
+
+    unsigned int size() const
+    {
+        return models.size();
+    }
+
+    // loads answered from the cache and loads that had to import
+    unsigned int getHits() const
+    {
+        return hits;
+    }
+
+    unsigned int getMisses() const
+    {
+        return misses;
+    }
+
+private:
+    std::unordered_map<std::string, std::shared_ptr<Model> > models;
+    unsigned int hits;
+    unsigned int misses;
+
+    ModelCache() : hits(0), misses(0) {}
+
+    static std::string makeKey(const std::string &path, unsigned int flags, bool compactVertices, bool flip)
+    {
+        return FileSystem::canonicalPath(path) + '|' + std::to_string(flags) + (compactVertices ? "|compact" : "") +
+               (flip ? "|flip" : "");
+    }
+};
+
+#endif
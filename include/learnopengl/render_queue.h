@@ -0,0 +1,552 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/material.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/uniform.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// passes are drawn in this order
+enum RenderPass {
+    PASS_OPAQUE,
+    PASS_SKY,
+    PASS_TRANSPARENT
+};
+
+// fixed function state a draw needs, applied through GLState so unchanged values cost nothing
+struct RenderState {
+    bool cull;
+    GLenum cullFace;
+    GLenum depthFunc;
+
+    RenderState(bool cull = false, GLenum cullFace = GL_BACK, GLenum depthFunc = GL_LESS)
+        : cull(cull), cullFace(cullFace), depthFunc(depthFunc) {}
+};
+
+// everything needed to issue one draw call
+struct DrawCommand {
+    RenderPass pass;
+    Shader *shader;
+    // may be null when the textures are not owned by a material
+    const Material *material;
+    unsigned int vao;
+    // glDrawElementsBaseVertex with count indices from indexOffset (bytes) into the element buffer, otherwise glDrawArrays
+    bool indexed;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for indexed draws
+    GLenum indexType;
+    size_t indexOffset;
+    int baseVertex;
+    unsigned int first;
+    unsigned int count;
+    // 0 draws a single non instanced copy
+    unsigned int instanceCount;
+    // uploaded to the "model" uniform when set
+    bool hasModel;
+    glm::mat4 model;
+    RenderState state;
+    // vertex layout of the VAO, see Mesh::setVertexDecode
+    bool compactVertices;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+    // texture coordinate units per model space unit of the mesh, see computeUvDensity(); 0 when unknown
+    float uvDensity;
+
+    DrawCommand() : pass(PASS_OPAQUE), shader(nullptr), material(nullptr), vao(0), indexed(false), indexType(GL_UNSIGNED_INT),
+                    indexOffset(0), baseVertex(0), first(0), count(0), instanceCount(0), hasModel(false), model(1.0f), compactVertices(false), positionOffset(0.0f),
+                    positionScale(1.0f), uvDensity(0.0f) {}
+};
+
+// draws kept and dropped by frustum culling during one frame
+struct CullStats {
+    unsigned int visible;
+    unsigned int culled;
+};
+
+// draw calls issued during one frame, a multi draw counts once no matter how many draws it holds
+struct DrawCallStats {
+    unsigned int calls;
+    unsigned int batchedDraws;
+};
+
+// Collects the draws of a frame and issues them sorted by a 64 bit key, so draws sharing a program, material and VAO
+// end up next to each other. Opaque draws are ordered by state and then front to back, transparent draws purely back
+// to front. Keys are sorted with an LSD radix sort over index/key pairs; bytes that are equal in every key are skipped.
+//
+// Materials that bind the same textures and only differ in their texture array layers share a sort id. With multi draw
+// indirect enabled, every run of sorted opaque draws that only differ in their model matrix, mesh range, layers and
+// instance count is issued as one glMultiDrawElementsIndirect (or glMultiDrawArraysIndirect) with the indirect
+// variant of its shader, which reads the per draw data from a storage buffer by gl_DrawIDARB.
+class RenderQueue {
+public:
+    RenderQueue() : view(1.0f), farPlane(100.0f), pixelsPerUnit(1.0f), multiDrawIndirect(false)
+    {
+        frame.visible = frame.culled = 0;
+        previous = frame;
+        drawCalls.calls = drawCalls.batchedDraws = 0;
+        previousDrawCalls = drawCalls;
+    }
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    // starts a frame, depth is measured along the view direction and normalized by farPlane; bounded draws are culled
+    // against the frustum of projection * viewMatrix. viewportHeight in pixels tells the TextureStreamer how fine the
+    // textures of a draw are sampled
+    void begin(const glm::mat4 &viewMatrix, const glm::mat4 &projection, float farPlaneDistance, float viewportHeight)
+    {
+        view = viewMatrix;
+        farPlane = farPlaneDistance;
+        // a perspective projection maps a view space height of 2 / projection[1][1] at distance 1 onto the viewport
+        pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+        frustum.extract(projection * viewMatrix);
+        commands.clear();
+        keys.clear();
+        previous = frame;
+        frame.visible = frame.culled = 0;
+        previousDrawCalls = drawCalls;
+        drawCalls.calls = drawCalls.batchedDraws = 0;
+    }
+
+    // draws of shader are batched with indirect, built from an indirect vertex shader and the fragment shader of shader
+    void setIndirectShader(Shader &shader, Shader &indirect)
+    {
+        ShaderEntry &entry = shaders[shaderIndex(&shader)];
+        entry.indirect = &indirect;
+        entry.drawBase = indirect.getUniform<int>("drawBase");
+    }
+
+    // only takes effect when MultiDrawIndirect::load() found support
+    void setMultiDrawIndirect(bool enabled)
+    {
+        multiDrawIndirect = enabled && MultiDrawIndirect::isSupported();
+    }
+
+    bool getMultiDrawIndirect() const
+    {
+        return multiDrawIndirect;
+    }
+
+    // submits the draw only if bounds, given in model space, intersect the frustum; returns whether it was submitted
+    bool submit(const DrawCommand &command, const BoundingSphere &bounds)
+    {
+        BoundingSphere world = command.hasModel ? transformBounds(bounds, command.model) : bounds;
+        if (!frustum.intersects(world))
+        {
+            frame.culled++;
+            return false;
+        }
+        frame.visible++;
+        float depth = -(view * glm::vec4(world.center, 1.0f)).z;
+        // texture coordinates per pixel on the closest part of the bounds, a texture is taken to span the bounds once
+        // when the mesh doesn't say
+        float scale = bounds.radius > 0.0f ? world.radius / bounds.radius : 1.0f;
+        float uvPerUnit = command.uvDensity > 0.0f ? command.uvDensity / scale : 0.5f / std::max(world.radius, 1e-4f);
+        float nearest = std::max(depth - world.radius, 0.1f);
+        // about the angle the bounds cover, 1 once the camera is inside them
+        noteTextures(command, world.radius / std::max(depth, world.radius), uvPerUnit * nearest / pixelsPerUnit);
+        enqueue(command, depth);
+        return true;
+    }
+
+    // depth is taken from the translation of the model matrix, draws without one sort as if they were at the camera
+    void submit(const DrawCommand &command)
+    {
+        float depth = 0.0f;
+        if (command.hasModel)
+            depth = -(view * command.model[3]).z;
+        submit(command, depth);
+    }
+
+    // submits with an explicit view space depth
+    void submit(const DrawCommand &command, float depth)
+    {
+        // without bounds the closer draw counts for more, and the textures are needed at full resolution
+        noteTextures(command, 1.0f / std::max(depth, 1.0f), 0.0f);
+        enqueue(command, depth);
+    }
+
+    // sorts and issues every submitted draw, then empties the queue
+    void flush()
+    {
+        sort();
+        if (multiDrawIndirect)
+            gatherBatches();
+
+        unsigned int next = 0;
+        for (unsigned int i = 0; i < keys.size();)
+        {
+            if (next < batches.size() && batches[next].begin == i)
+            {
+                drawBatch(batches[next]);
+                i = batches[next++].end;
+                continue;
+            }
+            draw(commands[keys[i].index], shaders[keys[i].shader]);
+            i++;
+        }
+
+        commands.clear();
+        keys.clear();
+        batches.clear();
+    }
+
+    unsigned int size() const
+    {
+        return commands.size();
+    }
+
+    const Frustum& getFrustum() const
+    {
+        return frustum;
+    }
+
+    // counts objects culled outside the queue, like instances, towards the frame statistics
+    void addCullStats(unsigned int visible, unsigned int culled)
+    {
+        frame.visible += visible;
+        frame.culled += culled;
+    }
+
+    const CullStats& lastFrameStats() const
+    {
+        return previous;
+    }
+
+    const DrawCallStats& lastFrameDrawCalls() const
+    {
+        return previousDrawCalls;
+    }
+
+    // deletes the indirect buffers, needs the GL context. The material ids are forgotten as well, the materials they
+    // were keyed by usually go away with the models released alongside
+    void release()
+    {
+        indirect.release();
+        materialIds.clear();
+        std::vector<Material>().swap(textureSets);
+    }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        unsigned int index;
+        unsigned int shader;
+    };
+
+    // per shader data that survives between frames
+    struct ShaderEntry {
+        Shader *shader;
+        Uniform<glm::mat4> model;
+        Uniform<glm::vec3> positionOffset;
+        Uniform<glm::vec3> positionScale;
+        Uniform<int> compactVertices;
+        // variant drawn by multi draw indirect, null if the shader has none
+        Shader *indirect;
+        Uniform<int> drawBase;
+    };
+
+    // sorted draws [begin, end) issued as one multi draw, offset is the byte offset of the first indirect record
+    struct Batch {
+        unsigned int begin, end;
+        size_t offset;
+        unsigned int drawBase;
+    };
+
+    glm::mat4 view;
+    float farPlane;
+    float pixelsPerUnit;
+    Frustum frustum;
+    CullStats frame;
+    CullStats previous;
+    DrawCallStats drawCalls;
+    DrawCallStats previousDrawCalls;
+    bool multiDrawIndirect;
+    MultiDrawIndirect indirect;
+    std::vector<Batch> batches;
+    std::vector<DrawCommand> commands;
+    std::vector<SortEntry> keys;
+    std::vector<SortEntry> scratch;
+    // small ids handed out on first use, they only have to be stable, not dense
+    std::vector<ShaderEntry> shaders;
+    std::unordered_map<const Material*, unsigned int> materialIds;
+    // one material per id, copied so ids stay valid when the materials they were made from go away
+    std::vector<Material> textureSets;
+    std::unordered_map<unsigned int, unsigned int> vaoIds;
+
+    void enqueue(const DrawCommand &command, float depth)
+    {
+        SortEntry entry;
+        entry.shader = shaderIndex(command.shader);
+        entry.key = makeKey(command, entry.shader, depth);
+        entry.index = commands.size();
+        commands.push_back(command);
+        keys.push_back(entry);
+    }
+
+    // tells the TextureStreamer how much of the screen the textures of a draw are about to cover and how finely
+    static void noteTextures(const DrawCommand &command, float importance, float uvPerPixel)
+    {
+        if (!command.material)
+            return;
+        const std::vector<MaterialTexture> &textures = command.material->getTextures();
+        for (unsigned int i = 0; i < textures.size(); i++)
+            TextureStreamer::get().noteVisible(textures[i].id, importance, uvPerPixel);
+    }
+
+    // bit layout, from the most significant bit
+    //   opaque/sky:   pass 2 | shader 8 | material 14 | vao 16 | depth 24
+    //   transparent:  pass 2 | inverted depth 24 | shader 8 | material 14 | vao 16
+    uint64_t makeKey(const DrawCommand &command, unsigned int shaderId, float depth)
+    {
+        uint64_t pass = (uint64_t)command.pass & 0x3;
+        uint64_t shader = (uint64_t)shaderId & 0xFF;
+        uint64_t material = (uint64_t)materialId(command.material) & 0x3FFF;
+        uint64_t vao = (uint64_t)idFor(vaoIds, command.vao) & 0xFFFF;
+        uint64_t quantized = quantizeDepth(depth);
+
+        if (command.pass == PASS_TRANSPARENT)
+            return pass << 62 | (0xFFFFFF - quantized) << 38 | shader << 30 | material << 16 | vao;
+        return pass << 62 | shader << 54 | material << 40 | vao << 24 | quantized;
+    }
+
+    uint64_t quantizeDepth(float depth) const
+    {
+        float normalized = depth / farPlane;
+        if (normalized < 0.0f)
+            normalized = 0.0f;
+        if (normalized > 1.0f)
+            normalized = 1.0f;
+        return (uint64_t)(normalized * 16777215.0f);
+    }
+
+    unsigned int shaderIndex(Shader *shader)
+    {
+        for (unsigned int i = 0; i < shaders.size(); i++)
+            if (shaders[i].shader == shader)
+                return i;
+
+        ShaderEntry entry;
+        entry.shader = shader;
+        entry.model = shader->getUniform<glm::mat4>("model");
+        entry.positionOffset = shader->getUniform<glm::vec3>("positionOffset");
+        entry.positionScale = shader->getUniform<glm::vec3>("positionScale");
+        entry.compactVertices = shader->getUniform<int>("compactVertices");
+        entry.indirect = nullptr;
+        shaders.push_back(entry);
+        return shaders.size() - 1;
+    }
+
+    // materials that share their textures get the same id, so they sort next to each other and can be batched
+    unsigned int materialId(const Material *material)
+    {
+        std::unordered_map<const Material*, unsigned int>::iterator it = materialIds.find(material);
+        if (it != materialIds.end())
+            return it->second;
+
+        // id 0 is the null material, textureSets[i] has id i + 1
+        unsigned int id = 0;
+        if (material)
+        {
+            while (id < textureSets.size() && !textureSets[id].sharesTextures(*material))
+                id++;
+            if (id == textureSets.size())
+                textureSets.push_back(*material);
+            id++;
+        }
+        materialIds[material] = id;
+        return id;
+    }
+
+    static bool sharesTextures(const Material *a, const Material *b)
+    {
+        return a == b || (a && b && a->sharesTextures(*b));
+    }
+
+    template<typename T>
+    static unsigned int idFor(std::unordered_map<T, unsigned int> &ids, T object)
+    {
+        typename std::unordered_map<T, unsigned int>::iterator it = ids.find(object);
+        if (it != ids.end())
+            return it->second;
+        unsigned int id = ids.size();
+        ids[object] = id;
+        return id;
+    }
+
+    void applyState(const RenderState &renderState)
+    {
+        GLState &state = GLState::get();
+        if (renderState.cull)
+        {
+            state.enable(GL_CULL_FACE);
+            state.cullFace(renderState.cullFace);
+        }
+        else
+            state.disable(GL_CULL_FACE);
+        state.depthFunc(renderState.depthFunc);
+    }
+
+    void draw(const DrawCommand &command, const ShaderEntry &entry)
+    {
+        applyState(command.state);
+        command.shader->use();
+        if (command.material)
+            command.material->bind(*command.shader);
+        if (command.hasModel)
+            entry.model.set(command.model);
+        // unchanged values are skipped by the uniform cache, shaders without the uniforms ignore them
+        entry.positionOffset.set(command.positionOffset);
+        entry.positionScale.set(command.positionScale);
+        entry.compactVertices.set(command.compactVertices ? 1 : 0);
+
+        GLState::get().bindVertexArray(command.vao);
+        if (command.indexed)
+        {
+            if (command.instanceCount)
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, command.indexType, (void*)command.indexOffset,
+                                                  command.instanceCount, command.baseVertex);
+            else
+                glDrawElementsBaseVertex(GL_TRIANGLES, command.count, command.indexType, (void*)command.indexOffset,
+                                         command.baseVertex);
+        }
+        else
+        {
+            if (command.instanceCount)
+                glDrawArraysInstanced(GL_TRIANGLES, command.first, command.count, command.instanceCount);
+            else
+                glDrawArrays(GL_TRIANGLES, command.first, command.count);
+        }
+        drawCalls.calls++;
+    }
+
+    // whether b can be drawn by the same multi draw as a
+    static bool batchable(const DrawCommand &a, const DrawCommand &b)
+    {
+        return a.pass == b.pass && a.shader == b.shader && sharesTextures(a.material, b.material) && a.vao == b.vao &&
+               a.indexed == b.indexed && (!a.indexed || a.indexType == b.indexType) &&
+               a.compactVertices == b.compactVertices && (a.instanceCount > 0) == (b.instanceCount > 0) &&
+               a.state.cull == b.state.cull && (!a.state.cull || a.state.cullFace == b.state.cullFace) &&
+               a.state.depthFunc == b.state.depthFunc;
+    }
+
+    // finds the runs of opaque draws with an indirect shader and uploads their records in one go
+    void gatherBatches()
+    {
+        indirect.clear();
+        for (unsigned int i = 0; i < keys.size();)
+        {
+            const DrawCommand &first = commands[keys[i].index];
+            if (first.pass != PASS_OPAQUE || !shaders[keys[i].shader].indirect)
+            {
+                i++;
+                continue;
+            }
+
+            Batch batch;
+            batch.begin = i;
+            batch.offset = 0;
+            batch.drawBase = 0;
+            for (batch.end = i; batch.end < keys.size() && batchable(first, commands[keys[batch.end].index]); batch.end++)
+            {
+                const DrawCommand &command = commands[keys[batch.end].index];
+                unsigned int instances = command.instanceCount ? command.instanceCount : 1;
+                size_t offset;
+                if (command.indexed)
+                {
+                    unsigned int indexSize = command.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+                    offset = indirect.addElements(command.count, command.indexOffset / indexSize, command.baseVertex, instances);
+                }
+                else
+                    offset = indirect.addArrays(command.count, command.first, instances);
+
+                IndirectDrawData data;
+                data.model = command.hasModel ? command.model : glm::mat4(1.0f);
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    data.positionOffset[c] = command.positionOffset[c];
+                    data.positionScale[c] = command.positionScale[c];
+                }
+                glm::ivec2 layers = command.material ? command.material->getLayers() : glm::ivec2(0, 0);
+                data.diffuseLayer = layers.x;
+                data.specularLayer = layers.y;
+                unsigned int drawIndex = indirect.addDrawData(data);
+
+                if (batch.end == batch.begin)
+                {
+                    batch.offset = offset;
+                    batch.drawBase = drawIndex;
+                }
+            }
+            batches.push_back(batch);
+            i = batch.end;
+        }
+        indirect.upload();
+    }
+
+    void drawBatch(const Batch &batch)
+    {
+        const DrawCommand &command = commands[keys[batch.begin].index];
+        const ShaderEntry &entry = shaders[keys[batch.begin].shader];
+        Shader &shader = *entry.indirect;
+
+        applyState(command.state);
+        shader.use();
+        if (command.material)
+            command.material->bind(shader);
+        entry.drawBase.set((int)batch.drawBase);
+
+        GLState::get().bindVertexArray(command.vao);
+        unsigned int drawCount = batch.end - batch.begin;
+        if (command.indexed)
+            indirect.drawElements(command.indexType, batch.offset, drawCount);
+        else
+            indirect.drawArrays(batch.offset, drawCount);
+        drawCalls.calls++;
+        drawCalls.batchedDraws += drawCount;
+    }
+
+    // LSD radix sort over the 8 bytes of the keys, stable so equal keys keep their submission order
+    void sort()
+    {
+        unsigned int count = keys.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+
+        for (unsigned int byte = 0; byte < 8; byte++)
+        {
+            unsigned int shift = byte * 8;
+            unsigned int histogram[256] = {0};
+            for (unsigned int i = 0; i < count; i++)
+                histogram[(keys[i].key >> shift) & 0xFF]++;
+
+            // every key has the same value in this byte, the pass would not move anything
+            if (histogram[(keys[0].key >> shift) & 0xFF] == count)
+                continue;
+
+            unsigned int offset = 0;
+            for (unsigned int bucket = 0; bucket < 256; bucket++)
+            {
+                unsigned int size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+            for (unsigned int i = 0; i < count; i++)
+                scratch[histogram[(keys[i].key >> shift) & 0xFF]++] = keys[i];
+            keys.swap(scratch);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,403 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// one image inside a GL_TEXTURE_2D_ARRAY
+struct TextureLayer {
+    unsigned int texture;
+    unsigned int layer;
+};
+
+// Packs images into GL_TEXTURE_2D_ARRAY objects grouped by size, channel count and wrap mode, so materials that only
+// differ in their images bind the same textures and select theirs by layer. Like the TextureRegistry it finds images
+// again by canonical path and by content hash and counts references per layer.
+//
+// add() only reads the image header and reserves a layer; the arrays can't grow once they have storage, so commit()
+// allocates every array that got new layers and queues the uploads on the TextureLoader. Later adds go into freed
+// layers or a new array of the same group. Main thread only.
+//
+// Images that come with their own mip chain, like the pages of a texture atlas, are added with addBaked() and go into
+// arrays of their own with exactly that many levels. So do images with a baked block compressed file, their arrays
+// have the compressed format and the levels of the file.
+//
+// Arrays of images of TextureStreamer::MIN_SIZE and up get their storage from the TextureStreamer, which fills their
+// levels coarse to fine over the frames after commit().
+class TextureArrayPacker {
+public:
+    // the lower bound GL 3.3 guarantees for GL_MAX_ARRAY_TEXTURE_LAYERS
+    static const unsigned int MAX_LAYERS = 256;
+
+    static TextureArrayPacker& get()
+    {
+        static TextureArrayPacker packer;
+        return packer;
+    }
+
+    TextureArrayPacker(const TextureArrayPacker&) = delete;
+    TextureArrayPacker& operator=(const TextureArrayPacker&) = delete;
+
+    // reserves a layer for the image at path, contentHash is its TextureRegistry::hashFile or 0. The image is loaded
+    // with the TextureLoader's current flip setting by the next commit(). Returns false if the file isn't an image
+    bool add(const std::string &path, TextureWrapMode wrap, uint64_t contentHash, TextureLayer &result)
+    {
+        bool flip = TextureLoader::get().getFlipVertically();
+        int width, height, components, levels = 0;
+        GLenum format;
+        CompressedImage baked;
+        if (CompressedTextures::findBaked(path, flip, baked))
+        {
+            width = baked.width;
+            height = baked.height;
+            components = CompressedTextures::components(baked.baseFormat);
+            format = baked.internalFormat;
+            levels = baked.levelCount;
+        }
+        else if (stbi_info(path.c_str(), &width, &height, &components))
+        {
+            format = TextureLoader::internalFormat(components);
+            // the loader builds the full chain
+            levels = mipLevelCount(width, height);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+
+        bool clamp = wrap == WRAP_CLAMP_IF_ALPHA && components == 4;
+        uint64_t settings = (uint64_t)(clamp ? 1 : 0) << 1 | (flip ? 1 : 0);
+        std::string pathKey = std::to_string(settings) + '|' + FileSystem::canonicalPath(path);
+
+        std::unordered_map<std::string, uint64_t>::iterator byPathIt = byPath.find(pathKey);
+        if (byPathIt != byPath.end())
+        {
+            layers[byPathIt->second].references++;
+            // a model import may have prefetched the same file again
+            TextureLoader::get().discard(path);
+            result = layerOf(byPathIt->second);
+            return true;
+        }
+
+        uint64_t hash = contentHash ? contentHash : TextureRegistry::hashFile(path);
+        uint64_t contentKey = hash ? hash ^ (settings + 1) * 0x9E3779B97F4A7C15ull : 0;
+        std::unordered_map<uint64_t, uint64_t>::iterator byContentIt = contentKey ? byContent.find(contentKey) : byContent.end();
+        if (byContentIt != byContent.end())
+        {
+            Layer &layer = layers[byContentIt->second];
+            layer.references++;
+            layer.pathKeys.push_back(pathKey);
+            byPath[pathKey] = byContentIt->second;
+            // the model import may have started decoding the duplicate already
+            TextureLoader::get().discard(path);
+            result = layerOf(byContentIt->second);
+            return true;
+        }
+
+        uint64_t key = reserve(width, height, components, format, clamp, levels, result);
+        Layer &layer = layers[key];
+        layer.contentKey = contentKey;
+        layer.pathKeys.push_back(pathKey);
+        layer.path = path;
+        layer.flip = flip;
+        byPath[pathKey] = key;
+        if (contentKey)
+            byContent[contentKey] = key;
+        return true;
+    }
+
+    // reserves a layer for an RGBA8 image with its mip levels, levels[i] is (width >> i) x (height >> i). The pixels
+    // are taken from levels and uploaded by the next commit(); no path or hash leads other adds to the layer
+    void addBaked(int width, int height, std::vector<std::vector<unsigned char> > &levels, TextureLayer &result)
+    {
+        uint64_t key = reserve(width, height, 4, GL_RGBA8, false, levels.size(), result);
+        layers[key].levels.swap(levels);
+    }
+
+    // allocates the storage of new arrays and requests the pixels of every layer added since the last commit
+    void commit()
+    {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+        {
+            Array &array = arrays[i];
+            if (array.texture == 0 || array.allocated || array.layerCount == 0)
+                continue;
+
+            GLState::get().bindTextureForEdit(GL_TEXTURE_2D_ARRAY, array.texture);
+            bool compressed = TextureLoader::isCompressed(array.internalFormat);
+            if (TextureStreamer::shouldStream(array.width, array.height))
+                streamArray(array, compressed);
+            else
+            {
+                for (int level = 0; level < array.levels; level++)
+                {
+                    int width = std::max(array.width >> level, 1), height = std::max(array.height >> level, 1);
+                    if (compressed)
+                        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, width, height, array.layerCount, 0,
+                                               CompressedTextures::levelSize(array.internalFormat, width, height) * array.layerCount,
+                                               nullptr);
+                    else
+                        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, width, height, array.layerCount, 0,
+                                     TextureLoader::pixelFormat(array.components), GL_UNSIGNED_BYTE, nullptr);
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+                TextureStreamer::get().track(array.texture, arrayBytes(array));
+            }
+            GLState::get().bindTextureForEdit(GL_TEXTURE_2D_ARRAY, array.texture);
+            GLint wrap = array.clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            array.allocated = true;
+        }
+
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            std::unordered_map<uint64_t, Layer>::iterator it = layers.find(pending[i]);
+            TextureLayer layer = layerOf(pending[i]);
+            // also resets a reused layer of a streamed array until its own image arrives
+            if (TextureStreamer::get().isStreamed(layer.texture))
+                TextureStreamer::get().setPlaceholder(layer.texture, layer.layer, it->second.levels.empty() ?
+                                                      textureContentFromName(it->second.path) : CONTENT_COLOR);
+            if (it->second.levels.empty())
+            {
+                TextureLoader::get().loadLayer(it->second.path, it->second.flip, layer.texture, layer.layer);
+                continue;
+            }
+
+            const Array &array = arrays[it->second.array];
+            if (TextureStreamer::get().isStreamed(array.texture))
+            {
+                // the streamer takes the levels, the coarse ones go up right away
+                TextureStreamer::get().deliver(array.texture, layer.layer, it->second.levels, TextureLoader::get().getUploadRing());
+                std::vector<std::vector<unsigned char> >().swap(it->second.levels);
+                continue;
+            }
+            GLState::get().bindTextureForEdit(GL_TEXTURE_2D_ARRAY, array.texture);
+            for (unsigned int level = 0; level < it->second.levels.size(); level++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer.layer, std::max(array.width >> level, 1),
+                                std::max(array.height >> level, 1), 1, GL_RGBA, GL_UNSIGNED_BYTE, &it->second.levels[level][0]);
+            std::vector<std::vector<unsigned char> >().swap(it->second.levels);
+        }
+        pending.clear();
+    }
+
+    // takes another reference to a layer, like a second model sharing an atlas page
+    void retain(const TextureLayer &texture)
+    {
+        std::unordered_map<uint64_t, Layer>::iterator it = layers.find(layerKey(texture));
+        if (it != layers.end())
+            it->second.references++;
+    }
+
+    // gives back one reference to a layer, the layer is reused by later adds once none are left and the array is
+    // deleted with its last layer
+    void release(const TextureLayer &texture)
+    {
+        std::unordered_map<uint64_t, Layer>::iterator it = layers.find(layerKey(texture));
+        if (it == layers.end() || --it->second.references > 0)
+            return;
+
+        Layer &layer = it->second;
+        for (unsigned int i = 0; i < layer.pathKeys.size(); i++)
+            byPath.erase(layer.pathKeys[i]);
+        if (layer.contentKey)
+            byContent.erase(layer.contentKey);
+        Array &array = arrays[layer.array];
+        array.freeLayers.push_back(texture.layer);
+        // a freed layer of a streamed array is neither waited for nor decoded again
+        TextureStreamer::get().abandon(array.texture, texture.layer);
+        layers.erase(it);
+        pending.erase(std::remove(pending.begin(), pending.end(), layerKey(texture)), pending.end());
+
+        if (--array.references == 0)
+            destroy(array);
+    }
+
+    // deletes every array regardless of references, used before the context goes away
+    void releaseAll()
+    {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+            if (arrays[i].texture)
+                destroy(arrays[i]);
+        arrays.clear();
+        layers.clear();
+        byPath.clear();
+        byContent.clear();
+        pending.clear();
+    }
+
+    unsigned int arrayCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < arrays.size(); i++)
+            if (arrays[i].texture)
+                count++;
+        return count;
+    }
+
+    unsigned int layerCount() const
+    {
+        return layers.size();
+    }
+
+private:
+    struct Array {
+        unsigned int texture;
+        int width, height, components;
+        GLenum internalFormat;
+        bool clamp;
+        // mip levels every layer comes with
+        int levels;
+        // storage is allocated by commit(), layerCount layers deep
+        bool allocated;
+        unsigned int layerCount;
+        std::vector<unsigned int> freeLayers;
+        // layers in use
+        unsigned int references;
+    };
+
+    struct Layer {
+        unsigned int array;
+        unsigned int references;
+        // 0 when the file could not be hashed
+        uint64_t contentKey;
+        std::vector<std::string> pathKeys;
+        // what commit() requests from the loader
+        std::string path;
+        bool flip;
+        // pixels of a baked layer until commit() uploads them
+        std::vector<std::vector<unsigned char> > levels;
+    };
+
+    // deleted arrays keep their slot with texture 0, so the indices in Layer stay valid
+    std::vector<Array> arrays;
+    // by layerKey()
+    std::unordered_map<uint64_t, Layer> layers;
+    std::unordered_map<std::string, uint64_t> byPath;
+    std::unordered_map<uint64_t, uint64_t> byContent;
+    std::vector<uint64_t> pending;
+
+    TextureArrayPacker() {}
+
+    static uint64_t layerKey(const TextureLayer &layer)
+    {
+        return (uint64_t)layer.texture << 32 | layer.layer;
+    }
+
+    static TextureLayer layerOf(uint64_t key)
+    {
+        TextureLayer layer;
+        layer.texture = (unsigned int)(key >> 32);
+        layer.layer = (unsigned int)key;
+        return layer;
+    }
+
+    // takes a free layer of the group or a new one and queues it for the next commit(), returns its key
+    uint64_t reserve(int width, int height, int components, GLenum internalFormat, bool clamp, int levels, TextureLayer &result)
+    {
+        unsigned int arrayIndex = arrayFor(width, height, components, internalFormat, clamp, levels);
+        Array &array = arrays[arrayIndex];
+        result.texture = array.texture;
+        if (!array.freeLayers.empty())
+        {
+            result.layer = array.freeLayers.back();
+            array.freeLayers.pop_back();
+        }
+        else
+            result.layer = array.layerCount++;
+        array.references++;
+
+        uint64_t key = layerKey(result);
+        Layer &layer = layers[key];
+        layer.array = arrayIndex;
+        layer.references = 1;
+        layer.contentKey = 0;
+        layer.flip = false;
+        pending.push_back(key);
+        return key;
+    }
+
+    // an array of the group with a free layer, or a new one
+    unsigned int arrayFor(int width, int height, int components, GLenum internalFormat, bool clamp, int levels)
+    {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+        {
+            const Array &array = arrays[i];
+            if (array.texture == 0 || array.width != width || array.height != height || array.components != components ||
+                array.internalFormat != internalFormat || array.clamp != clamp || array.levels != levels)
+                continue;
+            if (!array.freeLayers.empty() || (!array.allocated && array.layerCount < MAX_LAYERS))
+                return i;
+        }
+
+        Array array;
+        glGenTextures(1, &array.texture);
+        array.width = width;
+        array.height = height;
+        array.components = components;
+        array.internalFormat = internalFormat;
+        array.clamp = clamp;
+        array.levels = levels;
+        array.allocated = false;
+        array.layerCount = 0;
+        array.references = 0;
+        arrays.push_back(array);
+        return arrays.size() - 1;
+    }
+
+    // storage for a large array the TextureStreamer fills, commit() gives every layer a placeholder until its image
+    // arrives
+    void streamArray(const Array &array, bool compressed)
+    {
+        TextureStreamer &streamer = TextureStreamer::get();
+        streamer.create(array.texture, GL_TEXTURE_2D_ARRAY, array.width, array.height, array.layerCount, array.levels,
+                        array.internalFormat, compressed ? 0 : TextureLoader::pixelFormat(array.components));
+        // layers released before their first commit are never delivered and must not hold back the others
+        for (unsigned int i = 0; i < array.freeLayers.size(); i++)
+            streamer.abandon(array.texture, array.freeLayers[i]);
+    }
+
+    // video memory of an array that isn't streamed
+    static size_t arrayBytes(const Array &array)
+    {
+        size_t bytes = 0;
+        for (int level = 0; level < array.levels; level++)
+        {
+            int width = std::max(array.width >> level, 1), height = std::max(array.height >> level, 1);
+            if (TextureLoader::isCompressed(array.internalFormat))
+                bytes += CompressedTextures::levelSize(array.internalFormat, width, height);
+            else
+                bytes += (size_t)width * height * array.components;
+        }
+        return bytes * array.layerCount;
+    }
+
+    void destroy(Array &array)
+    {
+        TextureStreamer::get().forget(array.texture);
+        GLState::get().forgetTexture(array.texture);
+        glDeleteTextures(1, &array.texture);
+        array.texture = 0;
+        array.freeLayers.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <glm/glm.hpp>
+#include <imstb_rectpack.h>
+
+#include <algorithm>
+#include <vector>
+
+// Packs small RGBA images into square atlas pages with stb_rect_pack and builds their mip chains on the CPU.
+//
+// Every image gets ATLAS_PADDING texels of its own edge texels around it, and the padded tiles are placed on a grid
+// of 2^(ATLAS_MIP_LEVELS - 1) texels. Each mip level is filtered tile by tile, so a tile covers whole texels down to
+// the last level and a level never averages texels of two neighbouring images; bilinear filtering at the tile border
+// only reaches into the padding, which still holds the image's own edge. Deeper levels would have to mix tiles, so
+// pages stop at ATLAS_MIP_LEVELS levels.
+
+const int ATLAS_MIP_LEVELS = 4;
+// texels around each image at level 0, one texel is left at the last level
+const int ATLAS_PADDING = 1 << (ATLAS_MIP_LEVELS - 1);
+const int ATLAS_MIN_PAGE_SIZE = 256;
+const int ATLAS_MAX_PAGE_SIZE = 2048;
+// larger images would leave room for fewer than four on a page, same size images share texture arrays instead
+const int ATLAS_MAX_IMAGE_SIZE = ATLAS_MAX_PAGE_SIZE / 2 - 2 * ATLAS_PADDING;
+// UVs that leave the image by less than this still let it into an atlas, they are clamped to its edge
+const float ATLAS_UV_TOLERANCE = 0.01f;
+
+// an image to pack, RGBA8 rows bottom up like the GL expects them
+struct AtlasImage {
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+// RGBA8, levels[i] is (size >> i) texels square
+struct AtlasPage {
+    int size;
+    std::vector<std::vector<unsigned char> > levels;
+};
+
+// where an image ended up, uv in the image maps to offset + uv * scale in its page
+struct AtlasPlacement {
+    unsigned int page;
+    glm::vec2 offset;
+    glm::vec2 scale;
+};
+
+// packs images, which must not be larger than ATLAS_MAX_IMAGE_SIZE, into as few pages as possible; all of them go
+// onto the smallest page size that holds everything at once, otherwise onto as many ATLAS_MAX_PAGE_SIZE pages as it
+// takes. placements gets one entry per image
+inline void buildAtlas(const std::vector<AtlasImage> &images, std::vector<AtlasPage> &pages, std::vector<AtlasPlacement> &placements)
+{
+    pages.clear();
+    placements.assign(images.size(), AtlasPlacement());
+    if (images.empty())
+        return;
+
+    // the packer works in grid cells, which keeps every tile aligned for the last mip level
+    const int cell = ATLAS_PADDING;
+    std::vector<stbrp_rect> rects(images.size());
+    for (unsigned int i = 0; i < images.size(); i++)
+    {
+        rects[i].id = i;
+        rects[i].w = (images[i].width + 2 * ATLAS_PADDING + cell - 1) / cell;
+        rects[i].h = (images[i].height + 2 * ATLAS_PADDING + cell - 1) / cell;
+    }
+
+    int pageSize = ATLAS_MIN_PAGE_SIZE;
+    std::vector<stbrp_node> nodes(ATLAS_MAX_PAGE_SIZE / cell);
+    stbrp_context context;
+    for (; pageSize < ATLAS_MAX_PAGE_SIZE; pageSize *= 2)
+    {
+        std::vector<stbrp_rect> attempt(rects);
+        stbrp_init_target(&context, pageSize / cell, pageSize / cell, &nodes[0], pageSize / cell);
+        if (stbrp_pack_rects(&context, &attempt[0], attempt.size()))
+            break;
+    }
+
+    // rects that didn't fit go onto the next page
+    std::vector<stbrp_rect> remaining(rects);
+    std::vector<stbrp_rect> placed;
+    while (!remaining.empty())
+    {
+        stbrp_init_target(&context, pageSize / cell, pageSize / cell, &nodes[0], pageSize / cell);
+        stbrp_pack_rects(&context, &remaining[0], remaining.size());
+
+        std::vector<stbrp_rect> next;
+        for (unsigned int i = 0; i < remaining.size(); i++)
+        {
+            if (!remaining[i].was_packed)
+            {
+                next.push_back(remaining[i]);
+                continue;
+            }
+            AtlasPlacement &placement = placements[remaining[i].id];
+            placement.page = pages.size();
+            placement.offset = glm::vec2(remaining[i].x * cell + ATLAS_PADDING, remaining[i].y * cell + ATLAS_PADDING) / (float)pageSize;
+            placement.scale = glm::vec2(images[remaining[i].id].width, images[remaining[i].id].height) / (float)pageSize;
+            placed.push_back(remaining[i]);
+        }
+        remaining.swap(next);
+
+        AtlasPage page;
+        page.size = pageSize;
+        page.levels.resize(ATLAS_MIP_LEVELS);
+        for (int level = 0; level < ATLAS_MIP_LEVELS; level++)
+            page.levels[level].assign((size_t)(pageSize >> level) * (pageSize >> level) * 4, 0);
+        pages.push_back(page);
+    }
+
+    for (unsigned int i = 0; i < placed.size(); i++)
+    {
+        const AtlasImage &image = images[placed[i].id];
+        AtlasPage &page = pages[placements[placed[i].id].page];
+        int tileX = placed[i].x * cell, tileY = placed[i].y * cell;
+        int tileWidth = placed[i].w * cell, tileHeight = placed[i].h * cell;
+
+        // level 0: the image with its edge texels repeated over the padding
+        std::vector<unsigned char> &base = page.levels[0];
+        for (int y = 0; y < tileHeight; y++)
+        {
+            int sourceY = std::min(std::max(y - ATLAS_PADDING, 0), image.height - 1);
+            for (int x = 0; x < tileWidth; x++)
+            {
+                int sourceX = std::min(std::max(x - ATLAS_PADDING, 0), image.width - 1);
+                const unsigned char *source = &image.pixels[((size_t)sourceY * image.width + sourceX) * 4];
+                unsigned char *target = &base[((size_t)(tileY + y) * page.size + tileX + x) * 4];
+                target[0] = source[0];
+                target[1] = source[1];
+                target[2] = source[2];
+                target[3] = source[3];
+            }
+        }
+
+        // 2x2 box filter inside the tile
+        for (int level = 1; level < ATLAS_MIP_LEVELS; level++)
+        {
+            const std::vector<unsigned char> &finer = page.levels[level - 1];
+            std::vector<unsigned char> &coarser = page.levels[level];
+            int finerSize = page.size >> (level - 1), coarserSize = page.size >> level;
+            for (int y = tileY >> level; y < (tileY + tileHeight) >> level; y++)
+            {
+                for (int x = tileX >> level; x < (tileX + tileWidth) >> level; x++)
+                {
+                    const unsigned char *top = &finer[((size_t)(2 * y) * finerSize + 2 * x) * 4];
+                    const unsigned char *bottom = top + (size_t)finerSize * 4;
+                    unsigned char *target = &coarser[((size_t)y * coarserSize + x) * 4];
+                    for (int c = 0; c < 4; c++)
+                        target[c] = (unsigned char)((top[c] + top[c + 4] + bottom[c] + bottom[c + 4] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+#endif
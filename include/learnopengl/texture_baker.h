@@ -0,0 +1,198 @@
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+#include <stb_image.h>
+
+#include <learnopengl/block_compression.h>
+#include <learnopengl/compressed_texture.h>
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Offline stage that compresses source images into the CompressedTextures files the loaders pick up instead. Every
+// image gets its full mip chain built on the CPU (see mip_generator.h). The block rows of all levels are encoded on a
+// thread pool. By TextureContent:
+//   colour  BC1, BC3 with an alpha channel or BC7 when asked for, BC4/BC5 for one or two channel images like the raw
+//           upload's GL_RED/GL_RG
+//   normal  BC5 keeps x and y, the shaders rebuild z
+//   height  only red is sampled, BC4
+class TextureBaker {
+public:
+    // flip has to match the TextureLoader setting the images are loaded with later, highQuality encodes colour
+    // images as BC7 instead of BC1/BC3 at the same size as BC3
+    TextureBaker(bool flip, bool highQuality) : flip(flip), highQuality(highQuality) {}
+
+    // bakes source unless its baked file is up to date, returns false if it can't be read or written
+    bool bake(const std::string &source, TextureContent content)
+    {
+        int width, height, components;
+        if (!stbi_info(source.c_str(), &width, &height, &components))
+        {
+            std::cout << "ERROR::TEXTURE_BAKER::READ " << source << std::endl;
+            return false;
+        }
+        CompressedImage image;
+        image.internalFormat = chooseFormat(content, components, image.baseFormat);
+        image.source = CompressedTextures::sourceStamp(source);
+
+        CompressedImage existing;
+        if (CompressedTextures::read(CompressedTextures::bakedPath(source), false, existing) && existing.source == image.source &&
+            existing.bottomUp == flip && existing.internalFormat == image.internalFormat)
+            return true;
+
+        unsigned char *data = stbi_load(source.c_str(), &width, &height, &components, 4);
+        if (!data)
+        {
+            std::cout << "ERROR::TEXTURE_BAKER::READ " << source << std::endl;
+            return false;
+        }
+        if (flip)
+            TextureLoader::flipRows(data, width, height, 4);
+        std::vector<unsigned char> level(data, data + (size_t)width * height * 4);
+        stbi_image_free(data);
+        // grey and alpha goes to red and green, like the raw GL_RG upload
+        if (components == 2)
+            for (size_t i = 0; i < level.size(); i += 4)
+                level[i + 1] = level[i + 3];
+
+        // every level down to 1x1
+        std::vector<std::vector<unsigned char> > mips;
+        buildMipChain(&level[0], width, height, 4, mipFilterFor(content, components), mips);
+        mips.insert(mips.begin(), std::move(level));
+
+        image.width = width;
+        image.height = height;
+        image.levelCount = mips.size();
+        image.bottomUp = flip;
+        image.levels.resize(mips.size());
+        BlockFormat format = CompressedTextures::blockFormat(image.internalFormat);
+        {
+            // bands of block rows, enough of them to keep the pool busy on the large levels
+            ThreadPool pool;
+            const int BAND_ROWS = 16;
+            for (unsigned int i = 0; i < mips.size(); i++)
+            {
+                int w = std::max(width >> i, 1), h = std::max(height >> i, 1);
+                image.levels[i].resize(compressedSize(format, w, h));
+                int blockRows = (h + 3) / 4;
+                for (int row = 0; row < blockRows; row += BAND_ROWS)
+                {
+                    const unsigned char *pixels = &mips[i][0];
+                    unsigned char *out = &image.levels[i][0];
+                    int last = std::min(row + BAND_ROWS, blockRows);
+                    pool.enqueue([=] { compressBlockRows(pixels, w, h, format, out, row, last); });
+                }
+            }
+            // the pool finishes every band before it is destroyed
+        }
+
+        if (!CompressedTextures::write(CompressedTextures::bakedPath(source), image))
+        {
+            std::cout << "ERROR::TEXTURE_BAKER::WRITE " << CompressedTextures::bakedPath(source) << std::endl;
+            return false;
+        }
+
+        size_t rawBytes = 0, bakedBytes = 0;
+        for (unsigned int i = 0; i < mips.size(); i++)
+        {
+            rawBytes += mips[i].size() / 4 * CompressedTextures::components(image.baseFormat);
+            bakedBytes += image.levels[i].size();
+        }
+        std::ostringstream report;
+        report.precision(1);
+        report << std::fixed << "TEXTURE::BAKE " << source << " " << width << "x" << height << " " << formatName(image.internalFormat)
+               << ": " << rawBytes / 1048576.0 << " MB -> " << bakedBytes / 1048576.0 << " MB with mips\n";
+        std::cout << report.str() << std::flush;
+        return true;
+    }
+
+    // bakes every .jpg, .jpeg and .png below directory as what its name suggests, returns how many failed
+    unsigned int bakeDirectory(const std::string &directory)
+    {
+        std::vector<std::string> images;
+        findImages(directory, images);
+        std::sort(images.begin(), images.end());
+        unsigned int failed = 0;
+        for (unsigned int i = 0; i < images.size(); i++)
+            if (!bake(images[i], textureContentFromName(images[i])))
+                failed++;
+        return failed;
+    }
+
+    // every .jpg, .jpeg and .png below directory
+    static void findImages(const std::string &directory, std::vector<std::string> &images)
+    {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir)
+            return;
+        while (dirent *entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            std::string path = directory + '/' + name;
+            struct stat status;
+            if (stat(path.c_str(), &status) != 0)
+                continue;
+            if (S_ISDIR(status.st_mode))
+                findImages(path, images);
+            else if (S_ISREG(status.st_mode) && isImage(name))
+                images.push_back(path);
+        }
+        closedir(dir);
+    }
+
+private:
+    bool flip;
+    bool highQuality;
+
+    static bool isImage(const std::string &name)
+    {
+        std::string extension = name.substr(name.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return name.find('.') != std::string::npos && (extension == "jpg" || extension == "jpeg" || extension == "png");
+    }
+
+    GLenum chooseFormat(TextureContent content, int components, GLenum &baseFormat) const
+    {
+        if (content == CONTENT_NORMAL)
+        {
+            baseFormat = GL_RG;
+            return GL_COMPRESSED_RG_RGTC2;
+        }
+        if (content == CONTENT_HEIGHT || components == 1)
+        {
+            baseFormat = GL_RED;
+            return GL_COMPRESSED_RED_RGTC1;
+        }
+        if (components == 2)
+        {
+            baseFormat = GL_RG;
+            return GL_COMPRESSED_RG_RGTC2;
+        }
+        baseFormat = components == 4 ? GL_RGBA : GL_RGB;
+        if (highQuality)
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        return components == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    static const char* formatName(GLenum internalFormat)
+    {
+        static const char *names[] = {"BC1", "BC3", "BC4", "BC5", "BC7"};
+        return names[CompressedTextures::blockFormat(internalFormat)];
+    }
+
+};
+
+#endif
@@ -0,0 +1,732 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/compressed_texture.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/upload_ring.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum TextureWrapMode {
+    WRAP_REPEAT,
+    // RGBA images are clamped to prevent semi-transparent borders, everything else repeats
+    WRAP_CLAMP_IF_ALPHA
+};
+
+// Decodes images on a thread pool while the main thread keeps loading. A request creates the GL texture name right
+// away so it can be stored in materials; the pixels are uploaded later by pump()/finish() on the main thread, which
+// owns the context. finish() has to be called before the textures are sampled.
+//
+// stbi_set_flip_vertically_on_load is a process wide flag in this stb_image version, so the loader never touches it:
+// every job records the loader's flip setting at request time and flips its own rows after decoding.
+//
+// The workers also build the mip chain of every 2D and array image (see mip_generator.h), the main thread uploads it
+// level by level and never calls glGenerateMipmap. An image with an up to date baked file (see CompressedTextures) is
+// read from that instead and uploaded block compressed with the mip levels of the file.
+//
+// Once createUploadRing() ran, the pixels go to the GL through an UploadRing instead of client memory: on a persistent
+// ring the workers copy every level in as soon as they are done, otherwise upload() does, and the GL calls return
+// without waiting for the copy. Images that don't fit into the ring at the moment take the client memory path.
+//
+// 2D and array images of TextureStreamer::MIN_SIZE and up are streamed instead: the texture gets its storage and a
+// placeholder when it is requested, the workers keep the levels in client memory and the TextureStreamer uploads them
+// coarse to fine over the following frames. finish() doesn't wait for them, update() has to run every frame.
+//
+// Worker threads that know which images they will need, like model imports, can prefetch() them. The decode starts
+// right away and a later load2D() or loadLayer() of the same path on the main thread claims the decoded pixels instead
+// of decoding again.
+class TextureLoader {
+public:
+    // large enough for a 2k RGBA image with its mipmaps, or a few smaller ones in flight
+    static const size_t UPLOAD_RING_SIZE = 32 * 1024 * 1024;
+
+    static TextureLoader& get()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // main thread, once the context is current. loader is the one glad was initialized with
+    void createUploadRing(GLADloadproc loader)
+    {
+        uploadRing.create(UPLOAD_RING_SIZE, loader);
+    }
+
+    // once per frame: uploads what was decoded since the last frame, streams the next levels of large images and
+    // decodes the levels the streamer gave back and needs again
+    void update()
+    {
+        pump();
+        TextureStreamer::get().update(uploadRing);
+
+        std::vector<TextureStreamer::Reload> reloads;
+        TextureStreamer::get().takeReloads(reloads);
+        for (unsigned int i = 0; i < reloads.size(); i++)
+        {
+            std::shared_ptr<Job> job = std::make_shared<Job>();
+            job->texture = reloads[i].texture;
+            job->target = reloads[i].target;
+            job->layer = reloads[i].layer;
+            job->path = reloads[i].path;
+            job->wrap = WRAP_REPEAT;
+            job->flip = reloads[i].flip;
+            job->desiredComponents = 0;
+            job->baked = CompressedTextures::findBaked(job->path, job->flip, job->bakedImage);
+            job->streamed = true;
+            submit(job);
+        }
+    }
+
+    // for uploads of pixels the loader didn't decode, like the pages of a texture atlas
+    UploadRing& getUploadRing()
+    {
+        return uploadRing;
+    }
+
+    // deletes the upload ring, used before the context goes away
+    void release()
+    {
+        finish();
+        uploadRing.release();
+    }
+
+    // applies to requests made afterwards
+    void setFlipVertically(bool flip)
+    {
+        flipVertically = flip;
+    }
+
+    bool getFlipVertically() const
+    {
+        return flipVertically;
+    }
+
+    // pixel transfer format and sized internal format of images with the given number of channels
+    static GLenum pixelFormat(int components)
+    {
+        static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        return components >= 1 && components <= 4 ? formats[components - 1] : GL_RGB;
+    }
+
+    static GLenum internalFormat(int components)
+    {
+        static const GLenum formats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        return components >= 1 && components <= 4 ? formats[components - 1] : GL_RGB8;
+    }
+
+    static bool isCompressed(GLenum internalFormat)
+    {
+        return CompressedTextures::blockBytes(internalFormat) > 0;
+    }
+
+    // mirrors decoded pixels vertically in place, what stbi_set_flip_vertically_on_load does without the global
+    static void flipRows(unsigned char *data, int width, int height, int components)
+    {
+        size_t rowSize = (size_t)width * components;
+        std::vector<unsigned char> row(rowSize);
+        for (int y = 0; y < height / 2; y++)
+        {
+            unsigned char *top = data + y * rowSize;
+            unsigned char *bottom = data + (height - 1 - y) * rowSize;
+            std::memcpy(&row[0], top, rowSize);
+            std::memcpy(top, bottom, rowSize);
+            std::memcpy(bottom, &row[0], rowSize);
+        }
+    }
+
+    // starts decoding path on the pool without creating a texture, safe to call from any thread; the result is only
+    // uploaded once load2D() asks for the same path and flip setting
+    void prefetch(const std::string &path, bool flip)
+    {
+        // the baked file is looked up before taking the lock, it reads from disk
+        CompressedImage bakedImage;
+        bool baked = CompressedTextures::findBaked(path, flip, bakedImage);
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::string key = prefetchKey(path, flip);
+            if (prefetched.count(key))
+                return;
+            job = std::make_shared<Job>();
+            job->texture = 0;
+            job->target = GL_TEXTURE_2D;
+            job->layer = 0;
+            job->path = path;
+            job->wrap = WRAP_REPEAT;
+            job->flip = flip;
+            job->desiredComponents = 0;
+            job->baked = baked;
+            job->bakedImage = bakedImage;
+            // decided by whoever claims it
+            job->streamed = false;
+            job->claimed = false;
+            job->done = false;
+            job->discarded = false;
+            prefetched[key] = job;
+        }
+        pool.enqueue([this, job] { decode(*job); finished(job); });
+    }
+
+    // drops a prefetch of path that will never be claimed, like an image the TextureRegistry already has
+    void discard(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, std::shared_ptr<Job> >::iterator it = prefetched.find(prefetchKey(path, flipVertically));
+        if (it == prefetched.end())
+            return;
+        dropPrefetch(*it->second);
+        prefetched.erase(it);
+    }
+
+    unsigned int load2D(const std::string &path, TextureWrapMode wrap = WRAP_REPEAT)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+
+        // the header tells whether the image is streamed
+        CompressedImage bakedImage;
+        bool baked = CompressedTextures::findBaked(path, flipVertically, bakedImage);
+        int width = 0, height = 0, components = 0;
+        if (baked)
+        {
+            width = bakedImage.width;
+            height = bakedImage.height;
+            components = CompressedTextures::components(bakedImage.baseFormat);
+        }
+        else if (!stbi_info(path.c_str(), &width, &height, &components))
+            width = height = 0;
+        bool streamed = TextureStreamer::shouldStream(width, height);
+        if (streamed)
+            createStreamed(texture, path, wrap, width, height, components, baked ? &bakedImage : nullptr);
+
+        if (claim(path, flipVertically, texture, GL_TEXTURE_2D, 0, wrap, streamed))
+            return texture;
+
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->texture = texture;
+        job->target = GL_TEXTURE_2D;
+        job->layer = 0;
+        job->path = path;
+        job->wrap = wrap;
+        job->flip = flipVertically;
+        job->desiredComponents = 0;
+        job->baked = baked;
+        job->bakedImage = bakedImage;
+        job->streamed = streamed;
+        submit(job);
+        return texture;
+    }
+
+    // uploads path with all of its levels into one layer of a GL_TEXTURE_2D_ARRAY whose storage already holds images of
+    // the same size, format and level count. flip is the setting the layer was requested with
+    void loadLayer(const std::string &path, bool flip, unsigned int texture, unsigned int layer)
+    {
+        // the TextureArrayPacker registers large arrays with the streamer
+        bool streamed = TextureStreamer::get().isStreamed(texture);
+        if (streamed)
+            TextureStreamer::get().setSource(texture, layer, path, flip);
+        if (claim(path, flip, texture, GL_TEXTURE_2D_ARRAY, layer, WRAP_REPEAT, streamed))
+            return;
+
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->texture = texture;
+        job->target = GL_TEXTURE_2D_ARRAY;
+        job->layer = layer;
+        job->path = path;
+        job->wrap = WRAP_REPEAT;
+        job->flip = flip;
+        job->desiredComponents = 0;
+        job->baked = CompressedTextures::findBaked(path, flip, job->bakedImage);
+        job->streamed = streamed;
+        submit(job);
+    }
+
+    // faces in the order +X, -X, +Y, -Y, +Z, -Z
+    unsigned int loadCubemap(const std::vector<std::string> &faces)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GLState::get().bindTextureForEdit(GL_TEXTURE_CUBE_MAP, texture);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            std::shared_ptr<Job> job = std::make_shared<Job>();
+            job->texture = texture;
+            job->target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+            job->layer = 0;
+            job->path = faces[i];
+            job->wrap = WRAP_REPEAT;
+            job->flip = flipVertically;
+            // the faces are uploaded as GL_RGB, baked faces only with their first level
+            job->desiredComponents = 3;
+            job->baked = CompressedTextures::findBaked(faces[i], flipVertically, job->bakedImage);
+            job->streamed = false;
+            submit(job);
+        }
+        return texture;
+    }
+
+    // uploads every image decoded so far without waiting for the rest
+    void pump()
+    {
+        uploadRing.retire();
+        std::vector<std::shared_ptr<Job> > ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(completed);
+        }
+        for (unsigned int i = 0; i < ready.size(); i++)
+            upload(*ready[i]);
+    }
+
+    // blocks until every requested texture is uploaded, streamed ones only have their placeholder by then. Prefetches
+    // nobody claimed by then never will be, their pixels and staged regions are dropped
+    void finish()
+    {
+        while (outstanding > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                decoded.wait(lock, [this] { return !completed.empty(); });
+            }
+            pump();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::unordered_map<std::string, std::shared_ptr<Job> >::iterator it = prefetched.begin(); it != prefetched.end(); ++it)
+            dropPrefetch(*it->second);
+        prefetched.clear();
+    }
+
+    unsigned int pending() const
+    {
+        return outstanding;
+    }
+
+private:
+    struct Job {
+        unsigned int texture;
+        GLenum target;
+        // layer of a GL_TEXTURE_2D_ARRAY target
+        unsigned int layer;
+        std::string path;
+        TextureWrapMode wrap;
+        bool flip;
+        int desiredComponents;
+        // read from the baked file, bakedImage has its header until the worker adds the levels
+        bool baked;
+        CompressedImage bakedImage;
+        // a prefetched job is only handed to the main thread once load2D() claimed it, both guarded by mutex
+        bool claimed;
+        bool done;
+        bool discarded;
+        // handed to the TextureStreamer, which already created the storage
+        bool streamed;
+        // filled by the worker, mipLevels[i] is level i + 1 of data
+        bool loaded;
+        unsigned char *data;
+        int width, height, components;
+        std::vector<std::vector<unsigned char> > mipLevels;
+        // level i takes up [levelOffsets[i], levelOffsets[i + 1]) of all levels back to back
+        std::vector<size_t> levelOffsets;
+        // once staged, the levels only live in the ring
+        bool staged;
+        UploadRegion region;
+        // all levels of an image large enough to stream, level i is streamLevels[i]; the other pixel members are empty
+        std::vector<std::vector<unsigned char> > streamLevels;
+    };
+
+    std::mutex mutex;
+    std::condition_variable decoded;
+    std::vector<std::shared_ptr<Job> > completed;
+    // prefetched jobs nobody claimed yet, by prefetchKey()
+    std::unordered_map<std::string, std::shared_ptr<Job> > prefetched;
+    // only touched by the main thread
+    unsigned int outstanding;
+    bool flipVertically;
+    UploadRing uploadRing;
+    // declared last so the workers are joined before the members they use are destroyed
+    ThreadPool pool;
+
+    TextureLoader() : outstanding(0), flipVertically(false) {}
+
+    void submit(const std::shared_ptr<Job> &job)
+    {
+        job->claimed = true;
+        job->done = false;
+        job->discarded = false;
+        if (!job->streamed)
+            outstanding++;
+        pool.enqueue([this, job] { decode(*job); finished(job); });
+        // upload whatever is done already, so decoded images don't pile up in memory while loading continues
+        pump();
+    }
+
+    static std::string prefetchKey(const std::string &path, bool flip)
+    {
+        return (flip ? "1" : "0") + path;
+    }
+
+    // takes over a prefetched decode of path for the given target, returns false if there is none
+    bool claim(const std::string &path, bool flip, unsigned int texture, GLenum target, unsigned int layer, TextureWrapMode wrap,
+               bool streamed)
+    {
+        bool ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_map<std::string, std::shared_ptr<Job> >::iterator it = prefetched.find(prefetchKey(path, flip));
+            if (it == prefetched.end())
+                return false;
+
+            std::shared_ptr<Job> job = it->second;
+            prefetched.erase(it);
+            job->texture = texture;
+            job->target = target;
+            job->layer = layer;
+            job->wrap = wrap;
+            job->streamed = streamed;
+            job->claimed = true;
+            ready = job->done;
+            // a decode that is still running hands itself over in finished()
+            if (ready)
+                completed.push_back(job);
+        }
+        if (!streamed)
+            outstanding++;
+        if (ready)
+            decoded.notify_one();
+        return true;
+    }
+
+    // worker thread
+    void decode(Job &job)
+    {
+        job.data = nullptr;
+        job.staged = false;
+        job.loaded = job.baked && CompressedTextures::read(CompressedTextures::bakedPath(job.path), true, job.bakedImage);
+        if (job.loaded)
+        {
+            job.width = job.bakedImage.width;
+            job.height = job.bakedImage.height;
+            job.components = CompressedTextures::components(job.bakedImage.baseFormat);
+        }
+        else
+        {
+            // a baked file that went away since the request falls back to the source
+            job.baked = false;
+            job.data = stbi_load(job.path.c_str(), &job.width, &job.height, &job.components, job.desiredComponents);
+            job.loaded = job.data != nullptr;
+            if (!job.loaded)
+                return;
+            if (job.desiredComponents)
+                job.components = job.desiredComponents;
+            if (job.flip)
+                flipRows(job.data, job.width, job.height, job.components);
+            // cube maps are sampled without mipmaps
+            if (job.target == GL_TEXTURE_2D || job.target == GL_TEXTURE_2D_ARRAY)
+                buildMipChain(job.data, job.width, job.height, job.components,
+                              mipFilterFor(textureContentFromName(job.path), job.components), job.mipLevels);
+        }
+
+        unsigned int levels = job.baked ? job.bakedImage.levels.size() : 1 + job.mipLevels.size();
+        job.levelOffsets.assign(1, 0);
+        for (unsigned int level = 0; level < levels; level++)
+            job.levelOffsets.push_back(job.levelOffsets.back() + levelSize(job, level));
+        if ((job.target == GL_TEXTURE_2D || job.target == GL_TEXTURE_2D_ARRAY) && TextureStreamer::shouldStream(job.width, job.height))
+            takeLevels(job);
+        else if (uploadRing.isPersistent())
+            stage(job);
+    }
+
+    void finished(const std::shared_ptr<Job> &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->done = true;
+            if (!job->claimed)
+            {
+                if (job->discarded)
+                    dropPixels(*job);
+                return;
+            }
+            completed.push_back(job);
+        }
+        decoded.notify_one();
+    }
+
+    static size_t levelSize(const Job &job, unsigned int level)
+    {
+        if (job.baked)
+            return job.bakedImage.levels[level].size();
+        return (size_t)std::max(job.width >> level, 1) * std::max(job.height >> level, 1) * job.components;
+    }
+
+    static unsigned int levelCount(const Job &job)
+    {
+        return job.levelOffsets.size() - 1;
+    }
+
+    // client memory of a level that isn't staged
+    static const unsigned char* levelPixels(const Job &job, unsigned int level)
+    {
+        if (job.baked)
+            return &job.bakedImage.levels[level][0];
+        return level == 0 ? job.data : &job.mipLevels[level - 1][0];
+    }
+
+    // what the GL calls take as the pixels of a level, an offset into the bound ring once staged
+    static const void* levelData(const Job &job, unsigned int level)
+    {
+        if (job.staged)
+            return (const void*)(job.region.offset + job.levelOffsets[level]);
+        return levelPixels(job, level);
+    }
+
+    static size_t levelBytes(const Job &job, unsigned int level)
+    {
+        return job.levelOffsets[level + 1] - job.levelOffsets[level];
+    }
+
+    // copies every level into the ring and frees the client memory, from a worker only on a persistent ring. Does
+    // nothing when the ring has no room right now
+    void stage(Job &job)
+    {
+        if (!uploadRing.allocate(job.levelOffsets.back(), job.region))
+            return;
+        if (!uploadRing.map(job.region))
+        {
+            // nothing was read from the region, the fence just hands it back
+            uploadRing.submit(job.region);
+            return;
+        }
+        for (unsigned int level = 0; level < levelCount(job); level++)
+            uploadRing.write(job.region, job.levelOffsets[level], levelPixels(job, level), levelBytes(job, level));
+        if (!uploadRing.unmap())
+        {
+            uploadRing.submit(job.region);
+            return;
+        }
+        job.staged = true;
+        freePixels(job);
+    }
+
+    // moves the levels of a streamed image into streamLevels, level 0 included, worker thread
+    static void takeLevels(Job &job)
+    {
+        if (job.baked)
+        {
+            job.streamLevels.swap(job.bakedImage.levels);
+            return;
+        }
+        job.streamLevels.reserve(1 + job.mipLevels.size());
+        job.streamLevels.push_back(std::vector<unsigned char>(job.data, job.data + levelSize(job, 0)));
+        for (unsigned int i = 0; i < job.mipLevels.size(); i++)
+            job.streamLevels.push_back(std::move(job.mipLevels[i]));
+        stbi_image_free(job.data);
+        job.data = nullptr;
+        std::vector<std::vector<unsigned char> >().swap(job.mipLevels);
+    }
+
+    // storage, sampling state and placeholder of a 2D texture the TextureStreamer fills, main thread
+    void createStreamed(unsigned int texture, const std::string &path, TextureWrapMode wrap, int width, int height, int components,
+                        const CompressedImage *baked)
+    {
+        TextureStreamer &streamer = TextureStreamer::get();
+        if (baked)
+            streamer.create(texture, GL_TEXTURE_2D, width, height, 1, baked->levelCount, baked->internalFormat, 0);
+        else
+            streamer.create(texture, GL_TEXTURE_2D, width, height, 1, mipLevelCount(width, height), internalFormat(components),
+                            pixelFormat(components));
+        streamer.setPlaceholder(texture, 0, textureContentFromName(path));
+        streamer.setSource(texture, 0, path, flipVertically);
+
+        GLState::get().bindTextureForEdit(GL_TEXTURE_2D, texture);
+        GLint wrapMode = wrap == WRAP_CLAMP_IF_ALPHA && components == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    static void freePixels(Job &job)
+    {
+        stbi_image_free(job.data);
+        job.data = nullptr;
+        std::vector<std::vector<unsigned char> >().swap(job.mipLevels);
+        std::vector<std::vector<unsigned char> >().swap(job.bakedImage.levels);
+        std::vector<std::vector<unsigned char> >().swap(job.streamLevels);
+    }
+
+    // a job that will never be uploaded, any thread
+    void dropPixels(Job &job)
+    {
+        freePixels(job);
+        if (job.staged)
+            uploadRing.release(job.region);
+        job.staged = false;
+    }
+
+    // a prefetch that will never be claimed, with mutex held. A decode that is still running frees its pixels in
+    // finished()
+    void dropPrefetch(Job &job)
+    {
+        if (job.done)
+            dropPixels(job);
+        else
+            job.discarded = true;
+    }
+
+    // main thread
+    void upload(Job &job)
+    {
+        if (job.streamed)
+        {
+            uploadStreamed(job);
+            return;
+        }
+        outstanding--;
+        if (job.loaded && !job.streamLevels.empty())
+        {
+            // grew past TextureStreamer::MIN_SIZE since it was requested
+            std::cout << "ERROR::TEXTURE_LOADER::SIZE_MISMATCH " << job.path << std::endl;
+            freePixels(job);
+            return;
+        }
+        if (job.loaded && !job.staged)
+            stage(job);
+        if (job.staged)
+            uploadRing.bind();
+
+        if (job.target == GL_TEXTURE_2D_ARRAY)
+            uploadLayer(job);
+        else if (job.target != GL_TEXTURE_2D)
+            uploadFace(job);
+        else if (job.loaded)
+            upload2D(job);
+        else
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+
+        // the region is reused once the GPU is done with the calls above
+        if (job.staged)
+            uploadRing.submit(job.region);
+        freePixels(job);
+    }
+
+    void uploadStreamed(Job &job)
+    {
+        if (!job.loaded)
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+        else if (job.streamLevels.empty())
+            std::cout << "ERROR::TEXTURE_LOADER::SIZE_MISMATCH " << job.path << std::endl;
+        else
+            TextureStreamer::get().deliver(job.texture, job.layer, job.streamLevels, uploadRing);
+        if (!job.loaded || job.streamLevels.empty())
+            TextureStreamer::get().abandon(job.texture, job.layer);
+        freePixels(job);
+    }
+
+    void upload2D(Job &job)
+    {
+        GLState::get().bindTextureForEdit(GL_TEXTURE_2D, job.texture);
+        // rows of one and three channel levels aren't 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GLenum format = pixelFormat(job.components);
+        for (unsigned int level = 0; level < levelCount(job); level++)
+        {
+            int width = std::max(job.width >> level, 1), height = std::max(job.height >> level, 1);
+            if (job.baked)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, job.bakedImage.internalFormat, width, height, 0,
+                                       levelBytes(job, level), levelData(job, level));
+            else
+                glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, levelData(job, level));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount(job) - 1);
+        TextureStreamer::get().track(job.texture, job.levelOffsets.back());
+
+        GLint wrap = job.wrap == WRAP_CLAMP_IF_ALPHA && job.components == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // one face of a cube map, baked faces only with their first level
+    void uploadFace(Job &job)
+    {
+        if (!job.loaded)
+        {
+            std::cout << "Cubemap texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+        GLState::get().bindTextureForEdit(GL_TEXTURE_CUBE_MAP, job.texture);
+        if (job.baked)
+            glCompressedTexImage2D(job.target, 0, job.bakedImage.internalFormat, job.width, job.height, 0, levelBytes(job, 0),
+                                   levelData(job, 0));
+        else
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(job.target, 0, GL_RGB, job.width, job.height, 0, GL_RGB, GL_UNSIGNED_BYTE, levelData(job, 0));
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        TextureStreamer::get().track(job.texture, levelBytes(job, 0));
+    }
+
+    void uploadLayer(Job &job)
+    {
+        GLState::get().bindTextureForEdit(GL_TEXTURE_2D_ARRAY, job.texture);
+        GLint width = 0, height = 0, format = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        GLenum expected = job.baked ? job.bakedImage.internalFormat : internalFormat(job.components);
+        if (!job.loaded)
+        {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+        if (job.width != width || job.height != height || expected != (GLenum)format)
+        {
+            // the file changed since the array was sized for it
+            std::cout << "ERROR::TEXTURE_LOADER::LAYER_MISMATCH " << job.path << std::endl;
+            return;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int level = 0; level < levelCount(job); level++)
+        {
+            int levelWidth = std::max(job.width >> level, 1), levelHeight = std::max(job.height >> level, 1);
+            if (job.baked)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, job.layer, levelWidth, levelHeight, 1,
+                                          job.bakedImage.internalFormat, levelBytes(job, level), levelData(job, level));
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, job.layer, levelWidth, levelHeight, 1,
+                                pixelFormat(job.components), GL_UNSIGNED_BYTE, levelData(job, level));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+};
+
+#endif
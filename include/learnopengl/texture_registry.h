@@ -0,0 +1,260 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_loader.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process wide owner of every file backed texture. A texture is found again by its canonical path, and by a hash of
+// the file bytes, so the same image under another name or in another model's folder is decoded and uploaded once.
+// Both keys also hold the texture kind, wrap mode and flip setting, which change what ends up on the GPU.
+//
+// Every load returns a reference that is given back with release(); the texture is deleted with its last reference.
+// Main thread only, except hashFile() which model imports call on their worker threads.
+class TextureRegistry {
+public:
+    // loads that found the texture by path, by content and loads that created a new texture
+    struct Stats {
+        unsigned int pathHits;
+        unsigned int contentHits;
+        unsigned int misses;
+    };
+
+    static TextureRegistry& get()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    TextureRegistry(const TextureRegistry&) = delete;
+    TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+    // contentHash is the hashFile() of path when the caller already has it, 0 to let the registry read the file
+    unsigned int load2D(const std::string &path, TextureWrapMode wrap = WRAP_REPEAT, uint64_t contentHash = 0)
+    {
+        bool flip = TextureLoader::get().getFlipVertically();
+        uint64_t settings = (uint64_t)KIND_2D << 8 | (uint64_t)wrap << 1 | (flip ? 1 : 0);
+        std::string pathKey = std::to_string(settings) + '|' + FileSystem::canonicalPath(path);
+
+        unsigned int texture;
+        if (findByPath(pathKey, texture))
+        {
+            // a model import may have prefetched the same file again
+            TextureLoader::get().discard(path);
+            return texture;
+        }
+
+        uint64_t hash = contentHash ? contentHash : hashFile(path);
+        if (findByContent(hash, settings, pathKey, texture))
+        {
+            // the model import may have started decoding the duplicate already
+            TextureLoader::get().discard(path);
+            return texture;
+        }
+
+        texture = TextureLoader::get().load2D(path, wrap);
+        add(texture, pathKey, hash, settings);
+        return texture;
+    }
+
+    // faces in the order +X, -X, +Y, -Y, +Z, -Z
+    unsigned int loadCubemap(const std::vector<std::string> &faces)
+    {
+        bool flip = TextureLoader::get().getFlipVertically();
+        uint64_t settings = (uint64_t)KIND_CUBE << 8 | (flip ? 1 : 0);
+        std::string pathKey = std::to_string(settings);
+        for (unsigned int i = 0; i < faces.size(); i++)
+            pathKey += '|' + FileSystem::canonicalPath(faces[i]);
+
+        unsigned int texture;
+        if (findByPath(pathKey, texture))
+            return texture;
+
+        // the faces only match as a whole and in the same order
+        uint64_t hash = 0;
+        bool readable = true;
+        for (unsigned int i = 0; i < faces.size() && readable; i++)
+        {
+            uint64_t faceHash = hashFile(faces[i]);
+            readable = faceHash != 0;
+            hash = mix(hash ^ faceHash);
+        }
+        if (!readable)
+            hash = 0;
+        if (findByContent(hash, settings, pathKey, texture))
+            return texture;
+
+        texture = TextureLoader::get().loadCubemap(faces);
+        add(texture, pathKey, hash, settings);
+        return texture;
+    }
+
+    // takes another reference to a texture returned by one of the loads
+    void retain(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, Entry>::iterator it = entries.find(texture);
+        if (it != entries.end())
+            it->second.references++;
+    }
+
+    // gives back one reference, the texture is deleted once none are left
+    void release(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, Entry>::iterator it = entries.find(texture);
+        if (it == entries.end() || --it->second.references > 0)
+            return;
+        evict(it);
+    }
+
+    // deletes every texture regardless of references, used before the context goes away
+    void releaseAll()
+    {
+        while (!entries.empty())
+            evict(entries.begin());
+    }
+
+    unsigned int size() const
+    {
+        return entries.size();
+    }
+
+    const Stats& getStats() const
+    {
+        return stats;
+    }
+
+    // 64 bit hash of the file contents, 0 if the file can't be read. Reads eight bytes per step, so hashing a 4k
+    // image costs a fraction of decoding it.
+    static uint64_t hashFile(const std::string &path)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+            return 0;
+
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        std::vector<unsigned char> buffer(1 << 16);
+        size_t read;
+        uint64_t length = 0;
+        while ((read = fread(&buffer[0], 1, buffer.size(), file)) > 0)
+        {
+            size_t i = 0;
+            for (; i + 8 <= read; i += 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, &buffer[i], 8);
+                hash = mix(hash ^ word);
+            }
+            for (; i < read; i++)
+                hash = mix(hash ^ buffer[i]);
+            length += read;
+        }
+        fclose(file);
+        hash = mix(hash ^ length);
+        // 0 is reserved for unreadable files
+        return hash ? hash : 1;
+    }
+
+private:
+    enum Kind {
+        KIND_2D,
+        KIND_CUBE
+    };
+
+    struct Entry {
+        unsigned int references;
+        // 0 when the file could not be hashed, such textures are only found by path
+        uint64_t contentKey;
+        std::vector<std::string> pathKeys;
+    };
+
+    std::unordered_map<unsigned int, Entry> entries;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    Stats stats;
+
+    TextureRegistry()
+    {
+        stats.pathHits = stats.contentHits = stats.misses = 0;
+    }
+
+    static uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDull;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    static uint64_t contentKey(uint64_t hash, uint64_t settings)
+    {
+        return hash ? mix(hash ^ mix(settings + 1)) : 0;
+    }
+
+    bool findByPath(const std::string &pathKey, unsigned int &texture)
+    {
+        std::unordered_map<std::string, unsigned int>::iterator it = byPath.find(pathKey);
+        if (it == byPath.end())
+            return false;
+        texture = it->second;
+        entries[texture].references++;
+        stats.pathHits++;
+        return true;
+    }
+
+    // on a hit the path becomes another name of the texture
+    bool findByContent(uint64_t hash, uint64_t settings, const std::string &pathKey, unsigned int &texture)
+    {
+        uint64_t key = contentKey(hash, settings);
+        if (key == 0)
+            return false;
+        std::unordered_map<uint64_t, unsigned int>::iterator it = byContent.find(key);
+        if (it == byContent.end())
+            return false;
+        texture = it->second;
+        Entry &entry = entries[texture];
+        entry.references++;
+        entry.pathKeys.push_back(pathKey);
+        byPath[pathKey] = texture;
+        stats.contentHits++;
+        return true;
+    }
+
+    void add(unsigned int texture, const std::string &pathKey, uint64_t hash, uint64_t settings)
+    {
+        Entry &entry = entries[texture];
+        entry.references = 1;
+        entry.contentKey = contentKey(hash, settings);
+        entry.pathKeys.push_back(pathKey);
+        byPath[pathKey] = texture;
+        if (entry.contentKey)
+            byContent[entry.contentKey] = texture;
+        stats.misses++;
+    }
+
+    void evict(std::unordered_map<unsigned int, Entry>::iterator it)
+    {
+        unsigned int texture = it->first;
+        for (unsigned int i = 0; i < it->second.pathKeys.size(); i++)
+            byPath.erase(it->second.pathKeys[i]);
+        if (it->second.contentKey)
+            byContent.erase(it->second.contentKey);
+        entries.erase(it);
+
+        TextureStreamer::get().forget(texture);
+        GLState::get().forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+};
+
+#endif
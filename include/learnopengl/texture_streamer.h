@@ -0,0 +1,744 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/block_compression.h>
+#include <learnopengl/compressed_texture.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/upload_ring.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Progressive residency for large textures. A streamed texture gets storage for its mip chain when it is requested,
+// and a neutral texel in its last level so it can be drawn from the first frame on. Once the loader decoded the image,
+// the levels up to TAIL_SIZE are uploaded right away and the rest one level per texture and frame, finest last, within
+// BYTES_PER_FRAME.
+//
+// GL_TEXTURE_BASE_LEVEL keeps sampling on the levels that are there. When a finer level arrives the base moves down
+// and GL_TEXTURE_MIN_LOD starts at 1 and fades to 0 over a few frames, so the extra detail blends in instead of
+// popping. The texture whose draws covered the most of the screen in the last frame (see noteVisible()) goes first.
+//
+// It counts the bytes of every texture, the small ones the loader uploads in one go included (see track()), and
+// remembers when each streamed texture was last drawn and the finest level its draws needed. Once setBudget() gave it
+// a budget, drawn textures only stream down to that level and free the finer levels they decoded, and when the total
+// goes over the budget the finest level of the least recently drawn texture that holds more than it needs is given
+// back, never its tail. Dropped levels are decoded from the file again once they are needed (see takeReloads()).
+// Giving levels back needs storage that is specified level by level, so only textures created while there is a budget
+// get it; the ones created before keep their immutable glTexStorage and count as pinned.
+//
+// Texture arrays stream as a whole, a level only becomes visible once every layer has it. Main thread only.
+class TextureStreamer {
+public:
+    // images whose larger side is at least this are streamed
+    static const int MIN_SIZE = 1024;
+    // levels up to this size go up as soon as the image is decoded and stay
+    static const int TAIL_SIZE = 128;
+    // upload budget per frame, a single level larger than this still goes up alone
+    static const size_t BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+    // a layer whose levels were given back and are needed again
+    struct Reload {
+        unsigned int texture;
+        GLenum target;
+        unsigned int layer;
+        std::string path;
+        bool flip;
+    };
+
+    // one streamed texture as the residency panel shows it
+    struct Residency {
+        unsigned int texture;
+        // file of the first layer, empty for pixels that didn't come from a file
+        std::string path;
+        int width, height, layers, levels;
+        // finest level sampled and finest level the last frame's draws needed, levels if it wasn't drawn
+        int base, required;
+        unsigned int framesUnused;
+        size_t bytes;
+        bool evictable;
+        // created without a budget, its glTexStorage levels can't be given back
+        bool immutable;
+    };
+
+    static TextureStreamer& get()
+    {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    static bool shouldStream(int width, int height)
+    {
+        return std::max(width, height) >= MIN_SIZE;
+    }
+
+    // loads glTexStorage2D/3D (GL 4.2 or ARB_texture_storage) with the loader glad was initialized with, without them
+    // every level is specified on its own
+    void load(GLADloadproc loader)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major * 10 + minor < 42 && !hasExtension("GL_ARB_texture_storage"))
+            return;
+        texStorage2D = (TexStorage2DProc)loader("glTexStorage2D");
+        texStorage3D = (TexStorage3DProc)loader("glTexStorage3D");
+    }
+
+    // bytes of video memory the textures may take, 0 (the default) for no limit. Only textures created while there is
+    // a budget can give levels back, the ones created before keep their immutable storage
+    void setBudget(size_t bytes)
+    {
+        budget = bytes;
+    }
+
+    size_t getBudget() const
+    {
+        return budget;
+    }
+
+    // allocates a GL_TEXTURE_2D or a GL_TEXTURE_2D_ARRAY with layers layers and levels mip levels in the sized
+    // internalFormat; format is the pixel transfer format, 0 for block compressed formats. Sampling stays on the last
+    // level until the layers are delivered, setPlaceholder() gives it something to show until then
+    void create(unsigned int texture, GLenum target, int width, int height, int layers, int levels, GLenum internalFormat, GLenum format)
+    {
+        forget(texture);
+        Streamed &streamed = textures[texture];
+        streamed.target = target;
+        streamed.width = width;
+        streamed.height = height;
+        streamed.layers = layers;
+        streamed.levels = levels;
+        streamed.internalFormat = internalFormat;
+        streamed.format = format;
+        streamed.base = levels - 1;
+        streamed.minLod = 0.0f;
+        streamed.importance = streamed.lastImportance = 0.0f;
+        streamed.steppedFrame = frame;
+        streamed.lastUsedFrame = frame;
+        streamed.required = streamed.lastRequired = levels;
+        streamed.layerBase.assign(layers, levels);
+        streamed.abandoned.assign(layers, false);
+        streamed.pending.assign(layers, std::vector<std::vector<unsigned char> >());
+        streamed.sources.assign(layers, std::string());
+        streamed.flips.assign(layers, false);
+        streamed.reloading.assign(layers, false);
+        streamed.dropped.assign(layers, false);
+
+        GLState::get().bindTextureForEdit(target, texture);
+        streamed.mutableStorage = budget > 0 || (target == GL_TEXTURE_2D ? texStorage2D == nullptr : texStorage3D == nullptr);
+        if (streamed.mutableStorage)
+        {
+            // the finer levels get their storage when they are uploaded
+            streamed.storageBase = levels;
+            allocateLevel(texture, streamed, levels - 1);
+            glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+        else
+        {
+            if (target == GL_TEXTURE_2D)
+                texStorage2D(target, levels, internalFormat, width, height);
+            else
+                texStorage3D(target, levels, internalFormat, width, height, layers);
+            streamed.storageBase = 0;
+            for (int level = 0; level < levels; level++)
+                resident += levelSize(streamed, level) * layers;
+        }
+        clamp(texture, streamed);
+    }
+
+    // fills the last level of a layer with one texel that suits what the image holds: grey, a flat normal or no height.
+    // The layer counts as empty again until deliver() brings its image
+    void setPlaceholder(unsigned int texture, unsigned int layer, TextureContent content)
+    {
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it == textures.end() || layer >= (unsigned int)it->second.layers)
+            return;
+        Streamed &streamed = it->second;
+        unsigned char texel[4] = {128, 128, 128, 255};
+        if (content == CONTENT_NORMAL)
+            texel[2] = 255;
+        else if (content == CONTENT_HEIGHT)
+            texel[0] = texel[1] = texel[2] = 0;
+
+        std::vector<unsigned char> pixels;
+        if (streamed.format)
+            pixels.assign(texel, texel + CompressedTextures::components(streamed.format));
+        else
+        {
+            // a single block of the texel
+            unsigned char block[16 * 4];
+            for (int i = 0; i < 16; i++)
+                std::memcpy(block + i * 4, texel, 4);
+            BlockFormat blockFormat = CompressedTextures::blockFormat(streamed.internalFormat);
+            pixels.resize(blockBytes(blockFormat));
+            compressBlockRows(block, 4, 4, blockFormat, &pixels[0], 0, 1);
+        }
+        uploadLevel(texture, streamed, layer, streamed.levels - 1, pixels, nullptr);
+
+        streamed.layerBase[layer] = streamed.levels;
+        streamed.abandoned[layer] = false;
+        streamed.reloading[layer] = false;
+        streamed.dropped[layer] = false;
+        std::vector<std::vector<unsigned char> >().swap(streamed.pending[layer]);
+        updateBase(texture, streamed);
+    }
+
+    // the file a layer is decoded from again after its levels were given back. Layers without one, like atlas pages,
+    // keep their texture from giving levels back
+    void setSource(unsigned int texture, unsigned int layer, const std::string &path, bool flip)
+    {
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it == textures.end() || layer >= (unsigned int)it->second.layers)
+            return;
+        it->second.sources[layer] = path;
+        it->second.flips[layer] = flip;
+    }
+
+    bool isStreamed(unsigned int texture) const
+    {
+        return textures.count(texture) > 0;
+    }
+
+    // takes the decoded levels of a layer, levels[i] is level i. The tail is uploaded right away through ring, the
+    // rest by update(); levels that are still resident from before aren't uploaded again
+    void deliver(unsigned int texture, unsigned int layer, std::vector<std::vector<unsigned char> > &levels, UploadRing &ring)
+    {
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it == textures.end() || layer >= (unsigned int)it->second.layers)
+            return;
+        Streamed &streamed = it->second;
+        streamed.reloading[layer] = false;
+        streamed.dropped[layer] = false;
+        if (levels.size() != (size_t)streamed.levels || levels[0].size() != levelSize(streamed, 0))
+        {
+            // the file changed since the storage was sized for it
+            std::cout << "ERROR::TEXTURE_STREAMER::LEVEL_MISMATCH texture " << texture << " layer " << layer << std::endl;
+            abandon(texture, layer);
+            return;
+        }
+
+        int tail = tailLevel(streamed);
+        for (int level = streamed.levels - 1; level >= tail; level--)
+            if (level < streamed.layerBase[layer])
+                uploadLevel(texture, streamed, layer, level, levels[level], &ring);
+        streamed.layerBase[layer] = std::min(streamed.layerBase[layer], tail);
+        levels.resize(streamed.layerBase[layer]);
+        streamed.pending[layer].swap(levels);
+        updateBase(texture, streamed);
+    }
+
+    // a layer whose image failed to load stops holding back the others, its levels stay undefined like those of an
+    // array layer that was never filled. A 2D texture keeps showing its placeholder
+    void abandon(unsigned int texture, unsigned int layer)
+    {
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it == textures.end() || layer >= (unsigned int)it->second.layers)
+            return;
+        if (it->second.target == GL_TEXTURE_2D)
+        {
+            // counted like a texture that was uploaded in one go from now on
+            size_t bytes = storageBytes(it->second);
+            textures.erase(it);
+            pinned[texture] += bytes;
+            return;
+        }
+        std::vector<std::vector<unsigned char> >().swap(it->second.pending[layer]);
+        it->second.abandoned[layer] = true;
+        it->second.reloading[layer] = false;
+        it->second.dropped[layer] = false;
+        updateBase(texture, it->second);
+    }
+
+    // a draw with texture covers about importance of the screen this frame, and one screen pixel spans uvPerPixel
+    // texture coordinate units on its closest part, 0 when that isn't known. The largest importance and the finest
+    // level of a frame count
+    void noteVisible(unsigned int texture, float importance, float uvPerPixel)
+    {
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it == textures.end())
+            return;
+        Streamed &streamed = it->second;
+        streamed.importance = std::max(streamed.importance, importance);
+        streamed.lastUsedFrame = frame;
+
+        // the level whose texels are about one pixel big, trilinear filtering also reads the next coarser one
+        int level = 0;
+        float texels = uvPerPixel * std::max(streamed.width, streamed.height);
+        if (texels > 1.0f)
+            level = std::min((int)std::floor(std::log2(texels)), streamed.levels - 1);
+        streamed.required = std::min(streamed.required, level);
+    }
+
+    // once per frame before drawing: gives levels back while over budget, uploads the next levels that are needed and
+    // fades the ones that arrived earlier
+    void update(UploadRing &ring)
+    {
+        frame++;
+        std::unordered_map<unsigned int, Streamed>::iterator it;
+        for (it = textures.begin(); it != textures.end(); ++it)
+        {
+            Streamed &streamed = it->second;
+            streamed.lastImportance = streamed.importance;
+            streamed.importance = 0.0f;
+            streamed.lastRequired = streamed.required;
+            streamed.required = streamed.levels;
+            // under a budget the decoded levels finer than the draws need aren't kept in memory, they are decoded again
+            // once the draws come closer
+            if (budget && streamed.base <= wantedLevel(streamed))
+                dropPending(streamed);
+            if (streamed.minLod > 0.0f)
+            {
+                streamed.minLod = std::max(streamed.minLod - MIN_LOD_FADE, 0.0f);
+                clamp(it->first, streamed);
+            }
+        }
+        makeRoom(0, 0);
+
+        size_t uploaded = 0;
+        while (uploaded < BYTES_PER_FRAME)
+        {
+            std::unordered_map<unsigned int, Streamed>::iterator next = textures.end();
+            for (it = textures.begin(); it != textures.end(); ++it)
+            {
+                if (it->second.steppedFrame == frame || it->second.base <= wantedLevel(it->second))
+                    continue;
+                // the most important texture first, among equals the one that is the furthest from done
+                if (next == textures.end() || it->second.lastImportance > next->second.lastImportance ||
+                    (it->second.lastImportance == next->second.lastImportance && it->second.base > next->second.base))
+                    next = it;
+            }
+            if (next == textures.end())
+                break;
+
+            Streamed &streamed = next->second;
+            streamed.steppedFrame = frame;
+            int level = streamed.base - 1;
+            // a texture that was drawn may push others out, the rest only fills what the budget has left. Levels that
+            // have their storage already cost nothing
+            size_t storage = level < streamed.storageBase ? levelSize(streamed, level) * streamed.layers : 0;
+            bool drawn = streamed.lastRequired < streamed.levels;
+            if (budget && storage && !drawn && resident + storage > budget / 10 * 9)
+                continue;
+            if (!nextLevelReady(streamed))
+            {
+                requestReloads(next->first, streamed);
+                continue;
+            }
+
+            size_t bytes = 0;
+            for (int layer = 0; layer < streamed.layers; layer++)
+                if (!streamed.abandoned[layer] && streamed.layerBase[layer] > level)
+                    bytes += streamed.pending[layer][level].size();
+            if (uploaded > 0 && uploaded + bytes > BYTES_PER_FRAME)
+                break;
+            if (storage && !makeRoom(storage, next->first))
+                continue;
+
+            uploaded += bytes;
+            for (int layer = 0; layer < streamed.layers; layer++)
+            {
+                if (streamed.abandoned[layer] || streamed.layerBase[layer] <= level)
+                    continue;
+                uploadLevel(next->first, streamed, layer, level, streamed.pending[layer][level], &ring);
+                streamed.pending[layer].resize(level);
+                streamed.layerBase[layer] = level;
+            }
+            updateBase(next->first, streamed);
+        }
+    }
+
+    // hands out the layers the loader has to decode again
+    void takeReloads(std::vector<Reload> &result)
+    {
+        result.swap(reloads);
+        reloads.clear();
+    }
+
+    // counts a texture the loader uploaded in one go, bytes are added to what it has already
+    void track(unsigned int texture, size_t bytes)
+    {
+        pinned[texture] += bytes;
+        resident += bytes;
+    }
+
+    // stops counting and streaming a texture that is about to be deleted
+    void forget(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, size_t>::iterator pinnedIt = pinned.find(texture);
+        if (pinnedIt != pinned.end())
+        {
+            resident -= pinnedIt->second;
+            pinned.erase(pinnedIt);
+        }
+        std::unordered_map<unsigned int, Streamed>::iterator it = textures.find(texture);
+        if (it != textures.end())
+        {
+            resident -= storageBytes(it->second);
+            textures.erase(it);
+        }
+    }
+
+    // video memory of all textures, and the part of it that can't be given back
+    size_t residentBytes() const
+    {
+        return resident;
+    }
+
+    size_t pinnedBytes() const
+    {
+        size_t bytes = 0;
+        std::unordered_map<unsigned int, size_t>::const_iterator it;
+        for (it = pinned.begin(); it != pinned.end(); ++it)
+            bytes += it->second;
+        std::unordered_map<unsigned int, Streamed>::const_iterator streamed;
+        for (streamed = textures.begin(); streamed != textures.end(); ++streamed)
+            if (!isEvictable(streamed->second))
+                bytes += storageBytes(streamed->second);
+        return bytes;
+    }
+
+    // textures below their full resolution, and the bytes of decoded levels waiting in memory
+    unsigned int streamingCount() const
+    {
+        unsigned int count = 0;
+        std::unordered_map<unsigned int, Streamed>::const_iterator it;
+        for (it = textures.begin(); it != textures.end(); ++it)
+            if (it->second.base > 0)
+                count++;
+        return count;
+    }
+
+    size_t pendingBytes() const
+    {
+        size_t bytes = 0;
+        std::unordered_map<unsigned int, Streamed>::const_iterator it;
+        for (it = textures.begin(); it != textures.end(); ++it)
+            for (unsigned int layer = 0; layer < it->second.pending.size(); layer++)
+                for (unsigned int level = 0; level < it->second.pending[layer].size(); level++)
+                    bytes += it->second.pending[layer][level].size();
+        return bytes;
+    }
+
+    // every streamed texture, in no particular order
+    void residency(std::vector<Residency> &result) const
+    {
+        result.clear();
+        std::unordered_map<unsigned int, Streamed>::const_iterator it;
+        for (it = textures.begin(); it != textures.end(); ++it)
+        {
+            const Streamed &streamed = it->second;
+            Residency entry;
+            entry.texture = it->first;
+            entry.path = streamed.sources[0];
+            entry.width = streamed.width;
+            entry.height = streamed.height;
+            entry.layers = streamed.layers;
+            entry.levels = streamed.levels;
+            entry.base = streamed.base;
+            entry.required = streamed.lastRequired;
+            entry.framesUnused = frame - streamed.lastUsedFrame;
+            entry.bytes = storageBytes(streamed);
+            entry.evictable = isEvictable(streamed);
+            entry.immutable = !streamed.mutableStorage;
+            result.push_back(entry);
+        }
+    }
+
+private:
+    typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    typedef void (APIENTRYP TexStorage3DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height,
+                                              GLsizei depth);
+
+    struct Streamed {
+        GLenum target;
+        int width, height, layers, levels;
+        GLenum internalFormat;
+        // pixel transfer format, 0 for block compressed formats
+        GLenum format;
+        // specified level by level, so levels can be given back
+        bool mutableStorage;
+        // levels [storageBase, levels) have storage
+        int storageBase;
+        // sampling is clamped to [base, levels)
+        int base;
+        // GL_TEXTURE_MIN_LOD, fades from 1 to 0 after base moved down
+        float minLod;
+        // largest noteVisible() of the frame being drawn and of the one before
+        float importance, lastImportance;
+        // the update() that last uploaded a level of it, and the last one whose frame drew it
+        unsigned int steppedFrame;
+        unsigned int lastUsedFrame;
+        // finest level the draws of the frame being drawn and of the one before needed, levels when there were none
+        int required, lastRequired;
+        // per layer the finest level uploaded (levels before the image arrived) and the decoded levels
+        // [0, layerBase) still to go
+        std::vector<int> layerBase;
+        std::vector<std::vector<std::vector<unsigned char> > > pending;
+        // layers whose image failed to load
+        std::vector<bool> abandoned;
+        // see setSource(), and whether a reload of the layer is on its way
+        std::vector<std::string> sources;
+        std::vector<bool> flips;
+        std::vector<bool> reloading;
+        // layers whose decoded levels were given back or dropped, only these are decoded again; a layer whose first
+        // decode is still running has no levels either
+        std::vector<bool> dropped;
+    };
+
+    // about 8 frames from one level to the next
+    static constexpr float MIN_LOD_FADE = 0.125f;
+
+    std::unordered_map<unsigned int, Streamed> textures;
+    // bytes of the textures that aren't streamed
+    std::unordered_map<unsigned int, size_t> pinned;
+    std::vector<Reload> reloads;
+    size_t budget;
+    size_t resident;
+    // counts update() calls
+    unsigned int frame;
+    TexStorage2DProc texStorage2D;
+    TexStorage3DProc texStorage3D;
+
+    TextureStreamer() : budget(0), resident(0), frame(0), texStorage2D(nullptr), texStorage3D(nullptr) {}
+
+    static size_t levelSize(const Streamed &streamed, int level)
+    {
+        int width = std::max(streamed.width >> level, 1), height = std::max(streamed.height >> level, 1);
+        if (!streamed.format)
+            return CompressedTextures::levelSize(streamed.internalFormat, width, height);
+        return (size_t)width * height * CompressedTextures::components(streamed.format);
+    }
+
+    static size_t storageBytes(const Streamed &streamed)
+    {
+        size_t bytes = 0;
+        for (int level = streamed.storageBase; level < streamed.levels; level++)
+            bytes += levelSize(streamed, level) * streamed.layers;
+        return bytes;
+    }
+
+    // the first level that is uploaded with the tail
+    static int tailLevel(const Streamed &streamed)
+    {
+        int tail = streamed.levels - 1;
+        while (tail > 0 && std::max(streamed.width >> (tail - 1), streamed.height >> (tail - 1)) <= TAIL_SIZE)
+            tail--;
+        return tail;
+    }
+
+    static bool isEvictable(const Streamed &streamed)
+    {
+        if (!streamed.mutableStorage)
+            return false;
+        for (int layer = 0; layer < streamed.layers; layer++)
+            if (streamed.sources[layer].empty() && !streamed.abandoned[layer])
+                return false;
+        return true;
+    }
+
+    // the level a texture streams down to: under a budget what its draws needed in the last frame, everything when it
+    // wasn't drawn or there is no budget
+    int wantedLevel(const Streamed &streamed) const
+    {
+        return budget && streamed.lastRequired < streamed.levels ? streamed.lastRequired : 0;
+    }
+
+    // whether the level below base has been decoded for every layer
+    static bool nextLevelReady(const Streamed &streamed)
+    {
+        if (streamed.base == 0)
+            return false;
+        for (int layer = 0; layer < streamed.layers; layer++)
+            if (!streamed.abandoned[layer] && streamed.layerBase[layer] >= streamed.base &&
+                streamed.pending[layer].size() < (size_t)streamed.base)
+                return false;
+        return true;
+    }
+
+    // queues the dropped layers that lack the level below base and can be decoded again
+    void requestReloads(unsigned int texture, Streamed &streamed)
+    {
+        for (int layer = 0; layer < streamed.layers; layer++)
+        {
+            if (!streamed.dropped[layer] || streamed.reloading[layer] || streamed.sources[layer].empty() ||
+                streamed.layerBase[layer] < streamed.base || streamed.pending[layer].size() >= (size_t)streamed.base)
+                continue;
+            Reload reload = {texture, streamed.target, (unsigned int)layer, streamed.sources[layer], streamed.flips[layer]};
+            reloads.push_back(reload);
+            streamed.reloading[layer] = true;
+        }
+    }
+
+    // gives levels back until bytes more fit into the budget, never of the texture keep. Only levels that are finer
+    // than what their texture's draws needed last frame go, least recently drawn texture first. Returns whether it fit
+    bool makeRoom(size_t bytes, unsigned int keep)
+    {
+        while (budget && resident + bytes > budget)
+        {
+            std::unordered_map<unsigned int, Streamed>::iterator victim = textures.end(), it;
+            for (it = textures.begin(); it != textures.end(); ++it)
+            {
+                const Streamed &streamed = it->second;
+                if (it->first == keep || !isEvictable(streamed) || streamed.storageBase >= tailLevel(streamed) ||
+                    streamed.storageBase >= streamed.lastRequired)
+                    continue;
+                if (victim == textures.end() || streamed.lastUsedFrame < victim->second.lastUsedFrame ||
+                    (streamed.lastUsedFrame == victim->second.lastUsedFrame && streamed.storageBase < victim->second.storageBase))
+                    victim = it;
+            }
+            if (victim == textures.end())
+                return false;
+            evictLevel(victim->first, victim->second);
+        }
+        return true;
+    }
+
+    // gives back the finest level that has storage, its pixels are decoded again when it is needed
+    void evictLevel(unsigned int texture, Streamed &streamed)
+    {
+        int level = streamed.storageBase;
+        for (int layer = 0; layer < streamed.layers; layer++)
+        {
+            if (streamed.abandoned[layer] || streamed.layerBase[layer] > level)
+                continue;
+            streamed.layerBase[layer] = level + 1;
+            // the level only lived on the GPU, the reload that brings it back brings the finer levels too
+            std::vector<std::vector<unsigned char> >().swap(streamed.pending[layer]);
+            streamed.dropped[layer] = true;
+        }
+        streamed.storageBase = level + 1;
+        // sampling leaves the level before its storage goes
+        updateBase(texture, streamed);
+        releaseLevel(texture, streamed, level);
+    }
+
+    // frees the decoded levels still waiting in the layers that can be decoded again
+    static void dropPending(Streamed &streamed)
+    {
+        for (int layer = 0; layer < streamed.layers; layer++)
+        {
+            if (streamed.pending[layer].empty() || streamed.sources[layer].empty())
+                continue;
+            std::vector<std::vector<unsigned char> >().swap(streamed.pending[layer]);
+            streamed.dropped[layer] = true;
+        }
+    }
+
+    // moves base to the finest level every layer has
+    void updateBase(unsigned int texture, Streamed &streamed)
+    {
+        int finest = 0;
+        for (int layer = 0; layer < streamed.layers; layer++)
+            if (!streamed.abandoned[layer])
+                finest = std::max(finest, streamed.layerBase[layer]);
+        int base = std::min(std::max(finest, streamed.storageBase), streamed.levels - 1);
+        if (base == streamed.base)
+            return;
+        streamed.minLod = base < streamed.base ? 1.0f : 0.0f;
+        streamed.base = base;
+        clamp(texture, streamed);
+    }
+
+    void clamp(unsigned int texture, const Streamed &streamed)
+    {
+        GLState::get().bindTextureForEdit(streamed.target, texture);
+        glTexParameteri(streamed.target, GL_TEXTURE_BASE_LEVEL, streamed.base);
+        glTexParameterf(streamed.target, GL_TEXTURE_MIN_LOD, streamed.minLod);
+    }
+
+    // specifies one level of mutable storage for every layer, without pixels
+    void allocateLevel(unsigned int texture, Streamed &streamed, int level)
+    {
+        specifyLevel(texture, streamed, level, std::max(streamed.width >> level, 1), std::max(streamed.height >> level, 1));
+        streamed.storageBase = std::min(streamed.storageBase, level);
+        resident += levelSize(streamed, level) * streamed.layers;
+    }
+
+    // respecifies a level below the base as empty, which lets the driver free it
+    void releaseLevel(unsigned int texture, Streamed &streamed, int level)
+    {
+        specifyLevel(texture, streamed, level, 0, 0);
+        resident -= levelSize(streamed, level) * streamed.layers;
+    }
+
+    void specifyLevel(unsigned int texture, const Streamed &streamed, int level, int width, int height)
+    {
+        GLState::get().bindTextureForEdit(streamed.target, texture);
+        int depth = width ? streamed.layers : 0;
+        size_t size = streamed.format || !width ? 0 : CompressedTextures::levelSize(streamed.internalFormat, width, height) * depth;
+        if (streamed.target == GL_TEXTURE_2D && streamed.format)
+            glTexImage2D(GL_TEXTURE_2D, level, streamed.internalFormat, width, height, 0, streamed.format, GL_UNSIGNED_BYTE, nullptr);
+        else if (streamed.target == GL_TEXTURE_2D)
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, streamed.internalFormat, width, height, 0, size, nullptr);
+        else if (streamed.format)
+            glTexImage3D(streamed.target, level, streamed.internalFormat, width, height, depth, 0, streamed.format, GL_UNSIGNED_BYTE,
+                         nullptr);
+        else
+            glCompressedTexImage3D(streamed.target, level, streamed.internalFormat, width, height, depth, 0, size, nullptr);
+    }
+
+    // uploads one level of one layer, staged in ring when it has room
+    void uploadLevel(unsigned int texture, Streamed &streamed, int layer, int level, const std::vector<unsigned char> &pixels,
+                     UploadRing *ring)
+    {
+        for (int missing = streamed.storageBase - 1; missing >= level; missing--)
+            allocateLevel(texture, streamed, missing);
+
+        UploadRegion region;
+        bool allocated = ring && ring->allocate(pixels.size(), region);
+        bool staged = allocated && ring->map(region);
+        if (staged)
+        {
+            ring->write(region, 0, &pixels[0], pixels.size());
+            staged = ring->unmap();
+        }
+        if (allocated && !staged)
+        {
+            // nothing was read from the region, the fence just hands it back and the buffer is unbound for the client
+            // memory path
+            ring->submit(region);
+        }
+        if (staged)
+            ring->bind();
+        const void *data = staged ? (const void*)region.offset : (const void*)&pixels[0];
+
+        GLState::get().bindTextureForEdit(streamed.target, texture);
+        int width = std::max(streamed.width >> level, 1), height = std::max(streamed.height >> level, 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (streamed.target == GL_TEXTURE_2D && streamed.format)
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, streamed.format, GL_UNSIGNED_BYTE, data);
+        else if (streamed.target == GL_TEXTURE_2D)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, streamed.internalFormat, pixels.size(), data);
+        else if (streamed.format)
+            glTexSubImage3D(streamed.target, level, 0, 0, layer, width, height, 1, streamed.format, GL_UNSIGNED_BYTE, data);
+        else
+            glCompressedTexSubImage3D(streamed.target, level, 0, 0, layer, width, height, 1, streamed.internalFormat, pixels.size(), data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // the region is reused once the GPU is done with the call above
+        if (staged)
+            ring->submit(region);
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+};
+
+#endif
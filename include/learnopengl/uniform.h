@@ -0,0 +1,147 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reflected state of one active uniform of a linked program
+struct UniformSlot {
+    int location;
+    GLenum type;
+    int size;
+    // last value uploaded through the slot, large enough to hold a mat4
+    bool cached;
+    unsigned char value[sizeof(glm::mat4)];
+};
+
+// glUniform* overloads for every type a Uniform handle can hold
+inline void uploadUniform(int location, const int &value) { glUniform1i(location, value); }
+inline void uploadUniform(int location, const float &value) { glUniform1f(location, value); }
+inline void uploadUniform(int location, const glm::ivec2 &value) { glUniform2iv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void uploadUniform(int location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void uploadUniform(int location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void uploadUniform(int location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// All active uniforms of a program, filled once after linking. Slots are stored in an unordered_map whose nodes never
+// move, so handles can keep plain pointers to them.
+class UniformTable {
+public:
+    UniformTable() : program(0) {}
+
+    // enumerates the active uniforms of a linked program, array elements are registered both as "name" and "name[i]"
+    void reflect(unsigned int programID)
+    {
+        program = programID;
+        slots.clear();
+
+        int count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> buffer(maxLength + 1);
+
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(program, i, buffer.size(), &length, &size, &type, &buffer[0]);
+            std::string name(&buffer[0], length);
+
+            // members of uniform blocks have no location, their values live in buffers
+            int location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue;
+
+            std::string::size_type bracket = name.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == name.size())
+            {
+                std::string base = name.substr(0, bracket);
+                add(base, location, type, size);
+                add(name, location, type, 1);
+                for (int element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    add(elementName, glGetUniformLocation(program, elementName.c_str()), type, 1);
+                }
+            }
+            else
+                add(name, location, type, size);
+        }
+    }
+
+    // returns nullptr for names that are not active uniforms of the program
+    UniformSlot* find(const std::string &name) const
+    {
+        std::unordered_map<std::string, UniformSlot>::iterator it = slots.find(name);
+        return it == slots.end() ? nullptr : &it->second;
+    }
+
+    unsigned int getProgram() const
+    {
+        return program;
+    }
+
+private:
+    unsigned int program;
+    // the cached values inside the slots change through the const Shader setters
+    mutable std::unordered_map<std::string, UniformSlot> slots;
+
+    void add(const std::string &name, int location, GLenum type, int size)
+    {
+        UniformSlot slot;
+        slot.location = location;
+        slot.type = type;
+        slot.size = size;
+        slot.cached = false;
+        slots[name] = slot;
+    }
+};
+
+// A pre-resolved, typed uniform of one program. set() uploads only when the value differs from the last value uploaded
+// to the same uniform, so setting unchanged values costs a memcmp and no GL call. Like the Shader set functions it
+// expects the owning program to be bound.
+template<typename T>
+class Uniform {
+public:
+    Uniform() : slot(nullptr), program(0) {}
+    Uniform(UniformSlot *slot, unsigned int program) : slot(slot), program(program) {}
+
+    bool valid() const
+    {
+        return slot != nullptr;
+    }
+
+    void set(const T &value) const
+    {
+        static_assert(sizeof(T) <= sizeof(UniformSlot::value), "uniform type too large");
+        if (!slot)
+            return;
+
+        // values are only cached for the bound program, uploads to any other program are not tracked
+        bool bound = GLState::get().getProgram() == program;
+        if (bound && slot->cached && std::memcmp(slot->value, &value, sizeof(T)) == 0)
+            return;
+
+        uploadUniform(slot->location, value);
+        if (bound)
+        {
+            std::memcpy(slot->value, &value, sizeof(T));
+            slot->cached = true;
+        }
+    }
+
+private:
+    UniformSlot *slot;
+    unsigned int program;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <vector>
+
+// A uniform buffer object attached to a fixed binding point. Shaders are linked to the binding point once
+// (Shader::bindUniformBlock), after which every program sharing the block sees the same data. update() keeps a copy
+// of the last uploaded bytes and skips the upload when nothing changed.
+class UniformBuffer {
+public:
+    unsigned int ID;
+
+    UniformBuffer(unsigned int binding, unsigned int size) : ID(0), binding(binding), size(size), shadow(size), valid(false)
+    {
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // uploads size bytes from data if they differ from the previous upload, returns true if an upload happened
+    bool update(const void *data)
+    {
+        if (valid && std::memcmp(&shadow[0], data, size) == 0)
+            return false;
+
+        std::memcpy(&shadow[0], data, size);
+        valid = true;
+        glBindBuffer(GL_UNIFORM_BUFFER, ID);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        return true;
+    }
+
+    unsigned int getBinding() const
+    {
+        return binding;
+    }
+
+    // deletes the buffer, must be called while the context is still current
+    void release()
+    {
+        if (ID)
+            glDeleteBuffers(1, &ID);
+        ID = 0;
+        valid = false;
+    }
+
+private:
+    unsigned int binding;
+    unsigned int size;
+    std::vector<unsigned char> shadow;
+    bool valid;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+// glad is generated for GL 3.3, glBufferStorage (GL 4.4) is loaded by hand
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// a range of the ring, offset is what the GL pixel calls take as their data pointer while the ring's buffer is bound
+struct UploadRegion {
+    size_t offset;
+    size_t size;
+};
+
+// One GL_PIXEL_UNPACK_BUFFER the texture uploads are staged in, handed out front to back and reused once the GL is
+// done reading. A glTexImage or glTexSubImage call with the buffer bound returns right away and the copy into the
+// texture runs on the GPU's schedule, where an upload from client memory has to copy the pixels before it returns.
+//
+// With GL 4.4 or ARB_buffer_storage the buffer is mapped persistently and coherently once, so decoder threads write
+// into it directly; otherwise the main thread maps each region unsynchronized to fill it. A fence placed after the
+// GL calls that read a region keeps it from being handed out again before they finished. allocate() and release() are
+// thread safe, everything else needs the context.
+class UploadRing {
+public:
+    UploadRing() : buffer(0), capacity(0), head(0), mapped(nullptr), staging(nullptr) {}
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // creates the buffer, loader is the one glad was initialized with
+    void create(size_t size, GLADloadproc loader)
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        BufferStorageProc bufferStorage = nullptr;
+        if (major * 10 + minor >= 44 || hasExtension("GL_ARB_buffer_storage"))
+            bufferStorage = (BufferStorageProc)loader("glBufferStorage");
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        if (bufferStorage)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+        }
+        else
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = size;
+        head = 0;
+    }
+
+    // whether other threads can write() into their regions
+    bool isPersistent() const
+    {
+        return mapped != nullptr;
+    }
+
+    // reserves size bytes, returns false when the ring is too small or still busy with earlier uploads
+    bool allocate(size_t size, UploadRegion &region)
+    {
+        size = (size + 15) & ~(size_t)15;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (size == 0 || size > capacity)
+            return false;
+
+        // in flight is [tail, head), wrapping around the end of the buffer
+        size_t offset;
+        if (inFlight.empty())
+            offset = 0;
+        else if (head > inFlight.front().offset)
+        {
+            if (head + size <= capacity)
+                offset = head;
+            else if (size <= inFlight.front().offset)
+                offset = 0;
+            else
+                return false;
+        }
+        else if (head + size <= inFlight.front().offset)
+            offset = head;
+        else
+            return false;
+
+        Entry entry = {offset, size, nullptr, false};
+        inFlight.push_back(entry);
+        head = offset + size;
+        region.offset = offset;
+        region.size = size;
+        return true;
+    }
+
+    // copies size bytes to offset within region, from any thread when the ring is persistent, otherwise on the main
+    // thread between map() and unmap()
+    void write(const UploadRegion &region, size_t offset, const void *data, size_t size)
+    {
+        std::memcpy((mapped ? mapped + region.offset : staging) + offset, data, size);
+    }
+
+    // makes region writable when the ring isn't persistent, on the main thread, and leaves the buffer bound then.
+    // Returns false if the driver can't map it
+    bool map(const UploadRegion &region)
+    {
+        if (mapped)
+            return true;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        // nothing in flight overlaps the region, so the driver doesn't have to wait for the GPU
+        staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, region.offset, region.size,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        return staging != nullptr;
+    }
+
+    // returns false if the driver lost the data, the region has to be filled again then
+    bool unmap()
+    {
+        if (mapped)
+            return true;
+        staging = nullptr;
+        return glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+
+    // binds the buffer for pixel calls reading from region offsets
+    void bind() const
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    }
+
+    // unbinds the buffer after the GL calls reading region were issued and fences them, the region is reused once the
+    // GPU passed the fence
+    void submit(const UploadRegion &region)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry *entry = find(region);
+        if (entry)
+        {
+            entry->fence = fence;
+            entry->released = true;
+        }
+        else
+            glDeleteSync(fence);
+    }
+
+    // gives back a region nothing was uploaded from, like the staged pixels of a discarded prefetch. Any thread
+    void release(const UploadRegion &region)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry *entry = find(region);
+        if (entry)
+            entry->released = true;
+    }
+
+    // main thread: frees the regions the GPU is done with, oldest first, without waiting on the rest
+    void retire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!inFlight.empty() && inFlight.front().released)
+        {
+            Entry &entry = inFlight.front();
+            if (entry.fence)
+            {
+                if (glClientWaitSync(entry.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    break;
+                glDeleteSync(entry.fence);
+            }
+            inFlight.pop_front();
+        }
+    }
+
+    // bytes handed out and not retired yet
+    size_t used()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (inFlight.empty())
+            return 0;
+        size_t tail = inFlight.front().offset;
+        return head > tail ? head - tail : capacity - tail + head;
+    }
+
+    size_t size() const
+    {
+        return capacity;
+    }
+
+    // deletes the buffer and the fences, needs the GL context
+    void release()
+    {
+        if (buffer == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < inFlight.size(); i++)
+            if (inFlight[i].fence)
+                glDeleteSync(inFlight[i].fence);
+        inFlight.clear();
+        if (mapped)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        capacity = head = 0;
+        mapped = nullptr;
+    }
+
+private:
+    typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+    struct Entry {
+        size_t offset;
+        size_t size;
+        // set once the uploads reading the region are issued
+        GLsync fence;
+        // submitted or given back, retire() frees it once its fence, if any, has signaled
+        bool released;
+    };
+
+    unsigned int buffer;
+    size_t capacity;
+    // where the next region starts, guarded by mutex like inFlight
+    size_t head;
+    std::deque<Entry> inFlight;
+    std::mutex mutex;
+    // the persistent mapping of the whole buffer, or null
+    unsigned char *mapped;
+    // the mapped region between map() and unmap() without a persistent mapping
+    unsigned char *staging;
+
+    Entry* find(const UploadRegion &region)
+    {
+        for (unsigned int i = 0; i < inFlight.size(); i++)
+            if (inFlight[i].offset == region.offset && inFlight[i].size == region.size)
+                return &inFlight[i];
+        return nullptr;
+    }
+
+    static bool hasExtension(const char *name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+                return true;
+        return false;
+    }
+};
+
+#endif
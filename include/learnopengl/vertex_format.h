@@ -0,0 +1,81 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Compact 16 byte vertex, the GPU side alternative to the 56 byte float Vertex:
+//   position   3 x unsigned 16 bit, normalized to the mesh bounding box (positionOffset + positionScale * value)
+//   tangent    2 x signed 8 bit, octahedral encoded, decoded in the vertex shader
+//   normal     10:10:10:2 signed normalized, w holds the handedness of the bitangent
+//   texCoords  2 x half float
+struct PackedVertex {
+    uint16_t position[3];
+    int8_t tangent[2];
+    uint32_t normal;
+    uint16_t texCoords[2];
+};
+
+// IEEE half float with round to nearest, values too small for a normal half become 0
+inline uint16_t packHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    if (exponent <= 0)
+        return sign;
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    // round to nearest, a carry into the exponent is still the correct result
+    if (mantissa & 0x1000)
+        half++;
+    return half;
+}
+
+inline int32_t packSnorm(float value, float range)
+{
+    return (int32_t)std::floor(std::max(-1.0f, std::min(1.0f, value)) * range + 0.5f);
+}
+
+// GL_INT_2_10_10_10_REV with normalized components, w is -1 or 1
+inline uint32_t packSnorm1010102(const glm::vec3 &value, float w)
+{
+    uint32_t x = packSnorm(value.x, 511.0f) & 0x3FF;
+    uint32_t y = packSnorm(value.y, 511.0f) & 0x3FF;
+    uint32_t z = packSnorm(value.z, 511.0f) & 0x3FF;
+    uint32_t sign = (w < 0.0f ? -1 : 1) & 0x3;
+    return x | y << 10 | z << 20 | sign << 30;
+}
+
+// maps a unit vector onto the [-1, 1] square, the decode lives in the vertex shaders
+inline glm::vec2 octahedralEncode(const glm::vec3 &direction)
+{
+    float length = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+    if (length == 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec3 n = direction / length;
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+    return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// position in the box spanned by offset and scale, as 16 bit fractions
+inline uint16_t quantizeUnorm16(float value, float offset, float scale)
+{
+    float normalized = scale > 0.0f ? (value - offset) / scale : 0.0f;
+    return (uint16_t)std::floor(std::max(0.0f, std::min(1.0f, normalized)) * 65535.0f + 0.5f);
+}
+
+#endif
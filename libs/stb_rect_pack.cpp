@@ -0,0 +1,2 @@
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
\ No newline at end of file
@@ -37,21 +37,31 @@ struct SpotLight {
 };
 
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray texture_diffuse1;
+    sampler2DArray texture_specular1;
 
     float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+// texture array layers of the diffuse (x) and specular (y) texture
+flat in ivec2 Layers;
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight lampPointLight1;
+    PointLight lampPointLight2;
+    SpotLight lampSpotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
 
-uniform PointLight lampPointLight1;
-uniform PointLight lampPointLight2;
-uniform SpotLight lampSpotLight;
 uniform Material material;
-uniform DirLight dirLight;
-uniform vec3 viewPosition;
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -63,9 +73,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)).xxx);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -79,9 +89,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)));
     return (ambient + diffuse + specular);
 }
 
@@ -109,9 +119,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
      float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
      // combine results
-     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)));
      ambient *= attenuation * intensity;
      diffuse *= attenuation * intensity;
      specular *= attenuation * intensity;
@@ -6,15 +6,24 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out ivec2 Layers;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// texture array layers of the material, see Material
+uniform ivec2 materialLayers;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = aNormal;
-    TexCoords = aTexCoords;    
+    TexCoords = aTexCoords;
+    Layers = materialLayers;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
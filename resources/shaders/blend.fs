@@ -47,11 +47,19 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform PointLight lampPointLight1;
-uniform PointLight lampPointLight2;
-uniform SpotLight lampSpotLight;
-uniform DirLight dirLight;
-uniform vec3 viewPosition;
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight lampPointLight1;
+    PointLight lampPointLight2;
+    SpotLight lampSpotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
+
 uniform sampler2D texture1;
 uniform Material material;
 
@@ -0,0 +1,44 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out ivec2 Layers;
+
+// one entry per draw of a multi draw indirect, see IndirectDrawData. The transforms come from the instance attributes
+struct DrawData {
+    mat4 model;
+    vec3 positionOffset;
+    uint diffuseLayer;
+    vec3 positionScale;
+    uint specularLayer;
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+    DrawData draws[];
+};
+
+// entry of the first draw of the current multi draw
+uniform int drawBase;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
+
+void main()
+{
+    DrawData draw = draws[drawBase + gl_DrawIDARB];
+    vec3 position = draw.positionOffset + draw.positionScale * aPos;
+    FragPos = vec3(aInstanceModel * vec4(position, 1.0));
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    Layers = ivec2(draw.diffuseLayer, draw.specularLayer);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
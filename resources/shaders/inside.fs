@@ -13,6 +13,14 @@ struct PointLight {
     float quadratic;
 };
 
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -29,8 +37,8 @@ struct SpotLight {
 };
 
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray texture_diffuse1;
+    sampler2DArray texture_specular1;
 
     float shininess;
 };
@@ -38,13 +46,24 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+// texture array layers of the diffuse (x) and specular (y) texture
+flat in ivec2 Layers;
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight lampPointLight1;
+    PointLight lampPointLight2;
+    SpotLight lampSpotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
 
-uniform PointLight lampPointLight1;
-uniform PointLight lampPointLight2;
-uniform SpotLight lampSpotLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -56,9 +75,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)).xxx);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -89,9 +108,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
      float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
      // combine results
-     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)));
      ambient *= attenuation * intensity;
      diffuse *= attenuation * intensity;
      specular *= attenuation * intensity;
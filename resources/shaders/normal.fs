@@ -31,9 +31,9 @@ void main()
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
 
-    // obtain normal from normal map
-    vec3 normal = texture(normalMap, texCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);
+    // obtain normal from normal map, only x and y are read so a two channel baked map works too
+    vec2 normalXY = texture(normalMap, texCoords).rg * 2.0 - 1.0;
+    vec3 normal = normalize(vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
 
     // get diffuse color
     vec3 color = texture(diffuseMap, texCoords).rgb;
@@ -1,9 +1,11 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+// compact vertex layout: octahedral tangent, the bitangent handedness is stored in aNormal.w
+layout (location = 9) in vec2 aPackedTangent;
 
 out VS_OUT {
     vec3 FragPos;
@@ -20,19 +22,35 @@ uniform mat4 model;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
+uniform bool compactVertices = false;
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+     vec3 position = positionOffset + positionScale * aPos;
+     vs_out.FragPos = vec3(model * vec4(position, 1.0));
         vs_out.TexCoords = aTexCoords;
 
-        vec3 T = normalize(mat3(model) * aTangent);
-        vec3 B = normalize(mat3(model) * aBitangent);
-        vec3 N = normalize(mat3(model) * aNormal);
+        vec3 tangent = compactVertices ? octahedralDecode(aPackedTangent) : aTangent;
+        vec3 bitangent = compactVertices ? cross(aNormal.xyz, tangent) * aNormal.w : aBitangent;
+        vec3 T = normalize(mat3(model) * tangent);
+        vec3 B = normalize(mat3(model) * bitangent);
+        vec3 N = normalize(mat3(model) * aNormal.xyz);
         mat3 TBN = transpose(mat3(T, B, N));
 
         vs_out.TangentLightPos = TBN * lightPos;
         vs_out.TangentViewPos  = TBN * viewPos;
         vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
-        gl_Position = projection * view * model * vec4(aPos, 1.0);
+        gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -1,6 +1,33 @@
 #version 330 core
 out vec4 FragColor;
 
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
 struct DirLight {
     vec3 direction;
 
@@ -10,8 +37,8 @@ struct DirLight {
 };
 
 struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+    sampler2DArray texture_diffuse1;
+    sampler2DArray texture_specular1;
 
     float shininess;
 };
@@ -19,10 +46,23 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+// texture array layers of the diffuse (x) and specular (y) texture
+flat in ivec2 Layers;
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight lampPointLight1;
+    PointLight lampPointLight2;
+    SpotLight lampSpotLight;
+};
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
 
 uniform Material material;
-uniform DirLight dirLight;
-uniform vec3 viewPosition;
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -32,9 +72,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
 
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, vec3(TexCoords, Layers.x)));
+    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, vec3(TexCoords, Layers.y)));
     return (ambient + diffuse + specular);
 }
 
@@ -0,0 +1,33 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out ivec2 Layers;
+
+// meshes uploaded with the compact vertex layout store positions relative to their bounding box
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+
+// texture array layers of the material, see Material
+uniform ivec2 materialLayers;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
+
+void main()
+{
+    vec3 position = positionOffset + positionScale * aPos;
+    FragPos = vec3(aInstanceModel * vec4(position, 1.0));
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    Layers = materialLayers;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
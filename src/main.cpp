@@ -13,8 +13,22 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/model_cache.h>
+#include <learnopengl/geometry_registry.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/texture_array.h>
+#include <learnopengl/texture_baker.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
 
 struct PointLight {
     glm::vec3 position;
@@ -50,24 +64,116 @@ struct DirLight {
     glm::vec3 specular;
 };
 
+// std140 mirrors of the Camera and Lights uniform blocks declared by the lighting shaders,
+// member order follows the GLSL structs and the padding follows the std140 alignment rules
+struct PointLightStd140 {
+    glm::vec3 position; float pad0;
+    glm::vec3 specular; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad3[2];
+};
+
+struct SpotLightStd140 {
+    glm::vec3 position; float pad0;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    float constant;
+    float linear;
+    float quadratic;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+struct DirLightStd140 {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+struct LightsBlock {
+    DirLightStd140 dirLight;
+    PointLightStd140 lampPointLight1;
+    PointLightStd140 lampPointLight2;
+    SpotLightStd140 lampSpotLight;
+};
+
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPosition; float pad0;
+};
+
+static_assert(sizeof(PointLightStd140) == 80, "PointLight must match its std140 layout");
+static_assert(sizeof(SpotLightStd140) == 96, "SpotLight must match its std140 layout");
+static_assert(sizeof(DirLightStd140) == 64, "DirLight must match its std140 layout");
+static_assert(sizeof(CameraBlock) == 144, "Camera must match its std140 layout");
+
+// uniform buffer binding points
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+const unsigned int LIGHTS_BLOCK_BINDING = 1;
+
+// handles of the static meshes stored in the geometry registry
+struct SceneGeometry {
+    GeometryHandle cubeBack;
+    GeometryHandle cubeFront;
+    GeometryHandle cubeLeft;
+    GeometryHandle cubeRight;
+    GeometryHandle cubeBottom;
+    GeometryHandle cubeTop;
+    GeometryHandle roof;
+    GeometryHandle platform;
+    GeometryHandle skybox;
+    GeometryHandle path;
+};
+
+// tree instances with their world space bounds, culled every frame before the instance buffer is refilled
+struct Forest {
+    vector<glm::mat4> transforms;
+    SphereSet bounds;
+    vector<unsigned int> visible;
+    vector<glm::mat4> visibleTransforms;
+};
+
+// textures of the static meshes, each material binds its diffuse map to unit 0 and the next map to unit 1 (and 2)
+struct SceneMaterials {
+    Material wall;
+    Material floor;
+    Material grass;
+    Material roof;
+    Material skybox;
+    Material path;
+    Material windows;
+    Material windows2;
+};
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 unsigned int loadTexture(char const * path);
+TextureLayer loadTextureLayer(char const * path);
 unsigned int loadCubemap(vector<std::string> faces);
-void renderWindows(Shader& blendShader, unsigned int& windows, unsigned int& windows2);
-void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &blendShader, Shader &normalShader,
-               unsigned int& wall, unsigned int& floor, unsigned int& grassDiff, unsigned int& grassSpec, unsigned int& roof,
-               unsigned int& cubemapTexture, unsigned int& path, unsigned int& pathN, unsigned int& pathD, Model& tree, vector<glm::vec3> trees);
-void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &blendShader, Shader &normalShader,
-                 PointLight& lampPointLight1,  PointLight& lampPointLight2, SpotLight& lampSpotLight, DirLight& dirLight,
+void buildSceneGeometry(GeometryRegistry& registry, SceneGeometry& geometry);
+void buildSceneMaterials(SceneMaterials& materials, TextureLayer wall, TextureLayer floor, TextureLayer grassDiff, TextureLayer grassSpec,
+                         TextureLayer roof, unsigned int cubemapTexture, unsigned int path, unsigned int pathN, unsigned int pathD,
+                         unsigned int windows, unsigned int windows2);
+DrawCommand staticDraw(GeometryRegistry& registry, GeometryHandle handle, Shader& shader, const Material& material,
+                       const glm::mat4& model, const RenderState& state = RenderState(), RenderPass pass = PASS_OPAQUE);
+void renderWindows(Shader& blendShader, GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue);
+void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &outsideInstancedShader, Shader &blendShader, Shader &normalShader,
+               GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue, Model& tree, Forest& forest);
+void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &outsideInstancedShader, Shader &blendShader, Shader &normalShader,
                  Model& bed, Model& wardrobe, Model& kitchen, Model& rug, Model& tableSet, Model& door, Model& frame, Model& vase,
-                 Model& lamp, Model& lamp2, Model& lamp3, Model& tree,
-                 unsigned int& wall, unsigned int& floor, unsigned int& grassDiff, unsigned int& grassSpec, unsigned int& roof,
-                 unsigned int& cubemapTexture, unsigned int& path, unsigned int& pathN, unsigned int& pathD, unsigned int& windows, unsigned int& windows2,
-                 vector<glm::vec3>& trees);
+                 Model& lamp, Model& lamp2, Model& lamp3, Model& tree, Forest& forest,
+                 GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -151,21 +257,53 @@ void ProgramState::LoadFromFile(std::string filename) {
 }
 
 ProgramState *programState;
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, RenderQueue &queue);
+void updateCameraBlock(UniformBuffer& cameraBuffer, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition);
+void updateLightsBlock(UniformBuffer& lightsBuffer, const ProgramState& state);
+void benchmarkMipmaps(const std::vector<std::string>& images);
+
+int main(int argc, char **argv) {
+    // --bake-textures compresses the scene's images for the following runs and exits, --bc7 bakes colour images as BC7.
+    // --bench-mipmaps times the CPU mip chains against glGenerateMipmap and exits. --texture-budget <MB> sets the video
+    // memory the textures may take, 0 for no limit
+    bool bakeTextures = false, highQualityBake = false, benchMipmaps = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--bake-textures")
+            bakeTextures = true;
+        else if (argument == "--bc7")
+            highQualityBake = true;
+        else if (argument == "--bench-mipmaps")
+            benchMipmaps = true;
+        else if (argument == "--texture-budget" && i + 1 < argc)
+            TextureStreamer::get().setBudget((size_t) std::strtoul(argv[++i], NULL, 10) * 1024 * 1024);
+    }
+    if (bakeTextures) {
+        // every image of the scene is loaded without flipping, see the flip setting below
+        TextureBaker baker(false, highQualityBake);
+        unsigned int failed = baker.bakeDirectory(FileSystem::getPath("resources/textures")) +
+                              baker.bakeDirectory(FileSystem::getPath("resources/objects"));
+        return failed == 0 ? 0 : -1;
+    }
 
-int main() {
     // glfw: initialize and configure
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Cabin in forest", NULL, NULL);
+    // glfw window creation, 4.5 lets the render queue batch with multi draw indirect, 3.3 is the fallback
+    GLFWwindow *window = NULL;
+    const int contextVersions[][2] = {{4, 5}, {3, 3}};
+    for (const int* version : contextVersions) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Cabin in forest", NULL, NULL);
+        if (window != NULL)
+            break;
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -184,9 +322,25 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // baked block compressed images are only used in formats the context samples
+    CompressedTextures::loadSupport();
+    // texture pixels reach the GL through a ring of pixel buffers from here on
+    TextureLoader::get().createUploadRing((GLADloadproc) glfwGetProcAddress);
+    // large textures get immutable storage where the context has it and stream in their mip levels
+    TextureStreamer::get().load((GLADloadproc) glfwGetProcAddress);
+
+    if (benchMipmaps) {
+        std::vector<std::string> images;
+        TextureBaker::findImages(FileSystem::getPath("resources/textures"), images);
+        TextureBaker::findImages(FileSystem::getPath("resources/objects"), images);
+        std::sort(images.begin(), images.end());
+        benchmarkMipmaps(images);
+        glfwTerminate();
+        return 0;
+    }
 
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    // flip loaded texture's on the y-axis (before loading model), the loader applies this per image
+    TextureLoader::get().setFlipVertically(true);
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -203,13 +357,14 @@ int main() {
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
     // configure global opengl state
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState &glState = GLState::get();
+    glState.enable(GL_DEPTH_TEST);
+    glState.enable(GL_BLEND);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // enable face culling
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    glState.enable(GL_CULL_FACE);
+    glState.cullFace(GL_BACK);
     glFrontFace(GL_CW);
 
     // build and compile shaders
@@ -217,17 +372,28 @@ int main() {
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader insideShader("resources/shaders/inside.vs", "resources/shaders/inside.fs");
     Shader outsideShader("resources/shaders/outside.vs", "resources/shaders/outside.fs");
+    Shader outsideInstancedShader("resources/shaders/outside_instanced.vs", "resources/shaders/outside.fs");
     Shader blendShader("resources/shaders/blend.vs", "resources/shaders/blend.fs");
     Shader normalShader("resources/shaders/normal.vs", "resources/shaders/normal.fs");
 
-    stbi_set_flip_vertically_on_load(false);
+    // camera and light state is shared by all lighting shaders through uniform buffers
+    UniformBuffer cameraBuffer(CAMERA_BLOCK_BINDING, sizeof(CameraBlock));
+    UniformBuffer lightsBuffer(LIGHTS_BLOCK_BINDING, sizeof(LightsBlock));
+    Shader* lightingShaders[] = {&ourShader, &insideShader, &outsideShader, &outsideInstancedShader, &blendShader};
+    for (Shader* shader : lightingShaders) {
+        shader->bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+        shader->bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    }
+
+    TextureLoader::get().setFlipVertically(false);
 
-    //loading textures
-    unsigned int floor = loadTexture(FileSystem::getPath("resources/textures/floor/laminate_floor_02_diff_4k.jpg").c_str());
-    unsigned int wall = loadTexture(FileSystem::getPath("resources/textures/wall/wood_plank_wall_diff_4k.jpg").c_str());
-    unsigned int grassDiff = loadTexture(FileSystem::getPath("resources/textures/grass/forrest_ground_01_diff_4k.jpg").c_str());
-    unsigned int grassSpec = loadTexture(FileSystem::getPath("resources/textures/grass/forrest_ground_01_spec_4k.jpg").c_str());
-    unsigned int roof = loadTexture(FileSystem::getPath("resources/textures/roof/thatch_roof_angled_diff_4k.jpg").c_str());
+    //loading textures, the lighting shaders sample texture arrays
+    TextureLayer floor = loadTextureLayer(FileSystem::getPath("resources/textures/floor/laminate_floor_02_diff_4k.jpg").c_str());
+    TextureLayer wall = loadTextureLayer(FileSystem::getPath("resources/textures/wall/wood_plank_wall_diff_4k.jpg").c_str());
+    TextureLayer grassDiff = loadTextureLayer(FileSystem::getPath("resources/textures/grass/forrest_ground_01_diff_4k.jpg").c_str());
+    TextureLayer grassSpec = loadTextureLayer(FileSystem::getPath("resources/textures/grass/forrest_ground_01_spec_4k.jpg").c_str());
+    TextureLayer roof = loadTextureLayer(FileSystem::getPath("resources/textures/roof/thatch_roof_angled_diff_4k.jpg").c_str());
+    TextureArrayPacker::get().commit();
     unsigned int windows = loadTexture(FileSystem::getPath("resources/textures/window/window.png").c_str());
     unsigned int windows2 = loadTexture(FileSystem::getPath("resources/textures/window/prozor1.png").c_str());
     unsigned int path = loadTexture(FileSystem::getPath("resources/textures/path/concrete_rock_path_diff_4k.jpg").c_str());
@@ -244,6 +410,50 @@ int main() {
     };
     unsigned int cubemapTexture = loadCubemap(faces);
 
+    // static geometry (room, roof, ground, skybox, path) is built once and reused every frame
+    GeometryRegistry geometryRegistry;
+    SceneGeometry sceneGeometry;
+    buildSceneGeometry(geometryRegistry, sceneGeometry);
+    SceneMaterials sceneMaterials;
+    buildSceneMaterials(sceneMaterials, wall, floor, grassDiff, grassSpec, roof, cubemapTexture, path, pathN, pathD, windows, windows2);
+
+    // every draw of a frame is collected here and issued sorted by state and depth
+    RenderQueue renderQueue;
+
+    // where the context supports it, each shader gets a variant that draws a whole batch with one multi draw indirect
+    std::vector<std::unique_ptr<Shader>> indirectShaders;
+    if (MultiDrawIndirect::load((GLADloadproc) glfwGetProcAddress)) {
+        struct IndirectVariant {
+            Shader* shader;
+            const char* vertexPath;
+            const char* fragmentPath;
+        } variants[] = {
+                {&ourShader, "resources/shaders/indirect.vs", "resources/shaders/2.model_lighting.fs"},
+                {&insideShader, "resources/shaders/indirect.vs", "resources/shaders/inside.fs"},
+                {&outsideShader, "resources/shaders/indirect.vs", "resources/shaders/outside.fs"},
+                {&outsideInstancedShader, "resources/shaders/indirect_instanced.vs", "resources/shaders/outside.fs"}
+        };
+        // the variants need a newer GLSL than the rest, a driver that fails one keeps the regular draws for all of them
+        bool linked = true;
+        for (const IndirectVariant& variant : variants) {
+            indirectShaders.emplace_back(new Shader(variant.vertexPath, variant.fragmentPath));
+            linked = linked && indirectShaders.back()->isLinked();
+        }
+        if (linked) {
+            for (unsigned int i = 0; i < indirectShaders.size(); i++) {
+                indirectShaders[i]->bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+                indirectShaders[i]->bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+                renderQueue.setIndirectShader(*variants[i].shader, *indirectShaders[i]);
+            }
+            renderQueue.setMultiDrawIndirect(true);
+        } else {
+            std::cout << "ERROR::RENDER_QUEUE::INDIRECT_SHADERS_NOT_LINKED, drawing without multi draw indirect" << std::endl;
+            for (unsigned int i = 0; i < indirectShaders.size(); i++)
+                glDeleteProgram(indirectShaders[i]->ID);
+            indirectShaders.clear();
+        }
+    }
+
     //random generating positions for trees
     vector<glm::vec3> trees;
     for (int i = 0; i < 20; i++) {
@@ -278,42 +488,38 @@ int main() {
         trees.push_back(pos);
     }
 
-    // loading models
-    Model bed("resources/objects/bed/bed.obj");
-    bed.SetShaderTextureNamePrefix("material.");
-
-    Model kitchen("resources/objects/kitchen/kitchen.obj");
-    kitchen.SetShaderTextureNamePrefix("material.");
-
-    Model wardrobe("resources/objects/wardrobe/orman.obj");
-    wardrobe.SetShaderTextureNamePrefix("material.");
-
-    Model tableSet("resources/objects/tableSet/untitled.obj");
-    tableSet.SetShaderTextureNamePrefix("material.");
-
-    Model vase("resources/objects/flower/Scaniverse.obj");
-    vase.SetShaderTextureNamePrefix("material.");
-
-    Model rug("resources/objects/rug/rug.obj");
-    rug.SetShaderTextureNamePrefix("material.");
-
-    Model door("resources/objects/door/10057_wooden_door_v3_iterations-2.obj");
-    door.SetShaderTextureNamePrefix("material.");
-
-    Model frame("resources/objects/frame/dog2obj.obj");
-    frame.SetShaderTextureNamePrefix("material.");
-
-    Model lamp("resources/objects/lamp/Asta LG1.obj");
-    lamp.SetShaderTextureNamePrefix("material.");
-
-    Model lamp2("resources/objects/lamp/Asta LG1.obj");
-    lamp2.SetShaderTextureNamePrefix("material.");
-
-    Model lamp3("resources/objects/lamp/Asta LG1.obj");
-    lamp3.SetShaderTextureNamePrefix("material.");
+    // loading models, the files are imported in parallel and uploaded on this thread as each one finishes.
+    // the cache imports a file only once, the three lamps share one model
+    std::shared_ptr<Model> bed, kitchen, wardrobe, tableSet, vase, rug, door, frame, lamp, lamp2, lamp3, tree;
+    ModelRequest modelRequests[] = {
+            {&bed, "resources/objects/bed/bed.obj"},
+            {&kitchen, "resources/objects/kitchen/kitchen.obj"},
+            {&wardrobe, "resources/objects/wardrobe/orman.obj"},
+            {&tableSet, "resources/objects/tableSet/untitled.obj"},
+            {&vase, "resources/objects/flower/Scaniverse.obj"},
+            {&rug, "resources/objects/rug/rug.obj"},
+            {&door, "resources/objects/door/10057_wooden_door_v3_iterations-2.obj"},
+            {&frame, "resources/objects/frame/dog2obj.obj"},
+            {&lamp, "resources/objects/lamp/Asta LG1.obj"},
+            {&lamp2, "resources/objects/lamp/Asta LG1.obj"},
+            {&lamp3, "resources/objects/lamp/Asta LG1.obj"},
+            {&tree, "resources/objects/tree/tree.obj"}
+    };
+    // the models are stored with the compact 16 byte vertex layout on the GPU
+    for (ModelRequest& request : modelRequests) {
+        request.compactVertices = true;
+    }
+    ModelCache::get().load(modelRequests, sizeof(modelRequests) / sizeof(modelRequests[0]));
+    for (ModelRequest& request : modelRequests) {
+        (*request.model)->SetShaderTextureNamePrefix("material.");
+    }
 
-    Model tree("resources/objects/tree/tree.obj");
-    tree.SetShaderTextureNamePrefix("material.");
+    // trees don't move, so their transforms and bounds are computed once; only the visible ones are uploaded per frame
+    Forest forest;
+    for (const glm::vec3& position : trees) {
+        forest.transforms.push_back(glm::translate(glm::mat4(1.0f), position));
+        forest.bounds.add(transformBounds(tree->boundingSphere, forest.transforms.back()));
+    }
 
     //moon light
     DirLight& dirLight = programState->dirLight;
@@ -352,21 +558,20 @@ int main() {
     lampSpotLight.quadratic = 1.0f;
     lampSpotLight.cutOff = 70.0f;
     lampSpotLight.outerCutOff = 110.0f;
+    // wait for the background decodes of all textures above, including the model textures, and upload the rest;
+    // large ones show their placeholder and coarse levels until the render loop streamed the rest
+    TextureLoader::get().finish();
+
     //shader config
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
-    ourShader.use();
-    ourShader.setInt("material.texture_diffuse1", 0);
-    ourShader.setInt("material.texture_specular1", 1);
-    insideShader.use();
-    insideShader.setInt("material.texture_diffuse1", 0);
-    insideShader.setInt("material.texture_specular1", 1);
-    outsideShader.use();
-    outsideShader.setInt("material.texture_diffuse1", 0);
-    outsideShader.setInt("material.texture_specular1", 1);
+    for (Shader* shader : lightingShaders) {
+        shader->use();
+        shader->setInt("material.texture_diffuse1", 0);
+        shader->setInt("material.texture_specular1", 1);
+        shader->setFloat("material.shininess", 32.0f);
+    }
     blendShader.use();
-    blendShader.setInt("material.texture_diffuse1", 0);
-    blendShader.setInt("material.texture_specular1", 1);
     blendShader.setInt("texture1", 0);
     normalShader.use();
     normalShader.setInt("diffuseMap", 0);
@@ -376,6 +581,7 @@ int main() {
 
     // render loop
     while (!glfwWindowShouldClose(window)) {
+        GLState::get().beginFrame();
         // per-frame time logic
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
@@ -384,12 +590,18 @@ int main() {
         // input
         processInput(window);
 
+        // uploads the textures decoded since the last frame and the next mip levels of the streamed ones
+        TextureLoader::get().update();
+
         // render
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         // configure view/projection matrices
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
+        // the light block is only re-uploaded when a light actually changed
+        updateCameraBlock(cameraBuffer, view, projection, programState->camera.Position);
+        updateLightsBlock(lightsBuffer, *programState);
         normalShader.use();
         normalShader.setMat4("projection", projection);
         normalShader.setMat4("view", view);
@@ -400,13 +612,10 @@ int main() {
         normalShader.setVec3("viewPos", programState->camera.Position);
         normalShader.setVec3("lightPos", dirLight.direction);
         normalShader.setFloat("heightScale", heightScale);
-        renderScene(ourShader, skyboxShader, insideShader, outsideShader, blendShader, normalShader,
-                    lampPointLight1,  lampPointLight2,lampSpotLight, dirLight,
-                    bed, wardrobe, kitchen, rug, tableSet, door, frame, vase,
-                    lamp, lamp2, lamp3, tree,
-                    wall, floor, grassDiff, grassSpec, roof,
-                    cubemapTexture, path, pathN, pathD,windows, windows2,
-                    trees);
+        renderScene(ourShader, skyboxShader, insideShader, outsideShader, outsideInstancedShader, blendShader, normalShader,
+                    *bed, *wardrobe, *kitchen, *rug, *tableSet, *door, *frame, *vase,
+                    *lamp, *lamp2, *lamp3, *tree, forest,
+                    geometryRegistry, sceneGeometry, sceneMaterials, renderQueue);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         glfwSwapBuffers(window);
@@ -415,6 +624,16 @@ int main() {
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    geometryRegistry.release();
+    renderQueue.release();
+    ModelCache::get().release();
+    TextureRegistry::get().releaseAll();
+    TextureArrayPacker::get().releaseAll();
+    TextureLoader::get().release();
+    meshArena(false).release();
+    meshArena(true).release();
+    cameraBuffer.release();
+    lightsBuffer.release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -481,7 +700,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, RenderQueue &queue) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -542,6 +761,83 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Render stats");
+        const GLState::Stats& stats = GLState::get().lastFrame();
+        ImGui::Text("GL state calls issued: %u", stats.issued);
+        ImGui::Text("GL state calls elided: %u", stats.elided);
+        const CullStats& culling = queue.lastFrameStats();
+        ImGui::Text("Objects visible: %u", culling.visible);
+        ImGui::Text("Objects culled: %u", culling.culled);
+        const DrawCallStats& drawCalls = queue.lastFrameDrawCalls();
+        ImGui::Text("Draw calls: %u (%u draws batched)", drawCalls.calls, drawCalls.batchedDraws);
+        if (MultiDrawIndirect::isSupported()) {
+            bool multiDraw = queue.getMultiDrawIndirect();
+            if (ImGui::Checkbox("Multi draw indirect", &multiDraw))
+                queue.setMultiDrawIndirect(multiDraw);
+        }
+        const TextureRegistry::Stats& textures = TextureRegistry::get().getStats();
+        ImGui::Text("Textures: %u (shared by path %u, by content %u)", TextureRegistry::get().size(), textures.pathHits, textures.contentHits);
+        ImGui::Text("Texture arrays: %u (%u layers)", TextureArrayPacker::get().arrayCount(), TextureArrayPacker::get().layerCount());
+        ImGui::Text("Textures streaming: %u (%.1f MB waiting)", TextureStreamer::get().streamingCount(),
+                    TextureStreamer::get().pendingBytes() / 1048576.0);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Texture residency");
+        TextureStreamer& streamer = TextureStreamer::get();
+        if (streamer.getBudget() > 0)
+            ImGui::Text("Resident: %.1f MB of %.1f MB (%.1f MB pinned)", streamer.residentBytes() / 1048576.0,
+                        streamer.getBudget() / 1048576.0, streamer.pinnedBytes() / 1048576.0);
+        else
+            ImGui::Text("Resident: %.1f MB, no budget", streamer.residentBytes() / 1048576.0);
+        int budget = (int) (streamer.getBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("Budget (MB, 0 = no limit)", &budget, 0, 2048))
+            streamer.setBudget((size_t) budget * 1024 * 1024);
+
+        // the largest textures first
+        std::vector<TextureStreamer::Residency> residency;
+        streamer.residency(residency);
+        std::sort(residency.begin(), residency.end(), [](const TextureStreamer::Residency& a, const TextureStreamer::Residency& b) {
+            return a.bytes > b.bytes;
+        });
+        // textures streamed before there was a budget keep their immutable storage
+        unsigned int immutable = 0;
+        for (const TextureStreamer::Residency& texture : residency)
+            immutable += texture.immutable ? 1 : 0;
+        if (streamer.getBudget() > 0 && immutable > 0)
+            ImGui::TextWrapped("%u textures were created without a budget and keep all their levels, start with "
+                               "--texture-budget <MB> to let them give levels back", immutable);
+        if (ImGui::BeginTable("residency", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Texture");
+            ImGui::TableSetupColumn("Size");
+            ImGui::TableSetupColumn("Level (needed)");
+            ImGui::TableSetupColumn("Unused frames");
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableHeadersRow();
+            for (const TextureStreamer::Residency& texture : residency) {
+                std::string name = texture.path.substr(texture.path.find_last_of('/') + 1);
+                ImGui::TableNextColumn();
+                ImGui::Text("%s%s", name.empty() ? "atlas" : name.c_str(),
+                            texture.immutable ? " (immutable)" : texture.evictable ? "" : " (pinned)");
+                ImGui::TableNextColumn();
+                ImGui::Text("%dx%dx%d", texture.width, texture.height, texture.layers);
+                ImGui::TableNextColumn();
+                if (texture.required < texture.levels)
+                    ImGui::Text("%d (%d)", texture.base, texture.required);
+                else
+                    ImGui::Text("%d (-)", texture.base);
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", texture.framesUnused);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", texture.bytes / 1048576.0);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -559,221 +855,141 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 }
 
 unsigned int loadTexture(char const * path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
+    // shared through the registry, new images are decoded in the background and TextureLoader::finish() uploads them
+    return TextureRegistry::get().load2D(path, WRAP_CLAMP_IF_ALPHA);
+}
+
+// reserves a layer in the texture arrays, the pixels are requested by the next TextureArrayPacker::commit()
+TextureLayer loadTextureLayer(char const * path) {
+    TextureLayer layer = {0, 0};
+    TextureArrayPacker::get().add(path, WRAP_CLAMP_IF_ALPHA, 0, layer);
+    return layer;
+}
+
+unsigned int loadCubemap(vector<std::string> faces)
+{
+    return TextureRegistry::get().loadCubemap(faces);
+}
+
+// per image: what glGenerateMipmap used to cost the main thread at load, what building the same chain costs a loader
+// thread, and what uploading the finished levels costs the main thread instead
+void benchmarkMipmaps(const std::vector<std::string>& images) {
+    double gpuTotal = 0.0, cpuTotal = 0.0, uploadTotal = 0.0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (const std::string& path : images) {
+        int width, height, components;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+        if (!data)
+            continue;
+        GLenum format = TextureLoader::pixelFormat(components);
+        unsigned int textures[2];
+        glGenTextures(2, textures);
+        glFinish();
+
+        double start = glfwGetTime();
+        GLState::get().bindTextureForEdit(GL_TEXTURE_2D, textures[0]);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        double gpu = glfwGetTime() - start;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        start = glfwGetTime();
+        std::vector<std::vector<unsigned char> > levels;
+        buildMipChain(data, width, height, components, mipFilterFor(textureContentFromName(path), components), levels);
+        double cpu = glfwGetTime() - start;
 
+        start = glfwGetTime();
+        GLState::get().bindTextureForEdit(GL_TEXTURE_2D, textures[1]);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        for (unsigned int i = 0; i < levels.size(); i++)
+            glTexImage2D(GL_TEXTURE_2D, i + 1, format, std::max(width >> (i + 1), 1), std::max(height >> (i + 1), 1), 0, format,
+                         GL_UNSIGNED_BYTE, &levels[i][0]);
+        glFinish();
+        double upload = glfwGetTime() - start;
+
+        GLState::get().forgetTexture(textures[0]);
+        GLState::get().forgetTexture(textures[1]);
+        glDeleteTextures(2, textures);
         stbi_image_free(data);
+        gpuTotal += gpu;
+        cpuTotal += cpu;
+        uploadTotal += upload;
+        std::cout << "MIPMAPS " << path << " " << width << "x" << height << "x" << components << ": glGenerateMipmap "
+                  << gpu * 1000.0 << " ms, CPU chain " << cpu * 1000.0 << " ms, level upload " << upload * 1000.0 << " ms" << std::endl;
     }
-    else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    std::cout << "MIPMAPS total: glGenerateMipmap " << gpuTotal * 1000.0 << " ms, CPU chains " << cpuTotal * 1000.0
+              << " ms off the main thread, level uploads " << uploadTotal * 1000.0 << " ms" << std::endl;
 }
 
-unsigned int loadCubemap(vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+void updateCameraBlock(UniformBuffer& cameraBuffer, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPosition) {
+    CameraBlock block = {};
+    block.view = view;
+    block.projection = projection;
+    block.viewPosition = viewPosition;
+    cameraBuffer.update(&block);
+}
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+void packPointLight(PointLightStd140& packed, const PointLight& light) {
+    packed.position = light.position;
+    packed.ambient = light.ambient;
+    packed.diffuse = light.diffuse;
+    packed.specular = light.specular;
+    packed.constant = light.constant;
+    packed.linear = light.linear;
+    packed.quadratic = light.quadratic;
+}
 
-    return textureID;
+void updateLightsBlock(UniformBuffer& lightsBuffer, const ProgramState& state) {
+    // zero initialized so that the padding never makes two equal states compare different
+    LightsBlock block = {};
+    block.dirLight.direction = state.dirLight.direction;
+    block.dirLight.ambient = state.dirLight.ambient;
+    block.dirLight.diffuse = state.dirLight.diffuse;
+    block.dirLight.specular = state.dirLight.specular;
+
+    packPointLight(block.lampPointLight1, state.lampPointLight1);
+    packPointLight(block.lampPointLight2, state.lampPointLight2);
+
+    const SpotLight& spot = state.lampSpotLight;
+    block.lampSpotLight.position = spot.position;
+    block.lampSpotLight.direction = spot.direction;
+    block.lampSpotLight.cutOff = glm::cos(glm::radians(spot.cutOff));
+    block.lampSpotLight.outerCutOff = glm::cos(glm::radians(spot.outerCutOff));
+    block.lampSpotLight.constant = spot.constant;
+    block.lampSpotLight.linear = spot.linear;
+    block.lampSpotLight.quadratic = spot.quadratic;
+    block.lampSpotLight.ambient = spot.ambient;
+    block.lampSpotLight.diffuse = spot.diffuse;
+    block.lampSpotLight.specular = spot.specular;
+
+    lightsBuffer.update(&block);
 }
 
-void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &blendShader, Shader &normalShader,
-                 PointLight& lampPointLight1,  PointLight& lampPointLight2, SpotLight& lampSpotLight, DirLight& dirLight,
+void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &outsideInstancedShader, Shader &blendShader, Shader &normalShader,
                  Model& bed, Model& wardrobe, Model& kitchen, Model& rug, Model& tableSet, Model& door, Model& frame, Model& vase,
-                 Model& lamp, Model& lamp2, Model& lamp3, Model& tree,
-                 unsigned int& wall, unsigned int& floor, unsigned int& grassDiff, unsigned int& grassSpec, unsigned int& roof,
-                 unsigned int& cubemapTexture, unsigned int& path, unsigned int& pathN, unsigned int& pathD, unsigned int& windows, unsigned int& windows2,
-                 vector<glm::vec3>& trees)
+                 Model& lamp, Model& lamp2, Model& lamp3, Model& tree, Forest& forest,
+                 GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue)
                  {
-    // don't forget to enable shader before setting uniforms
-    ourShader.use();
-    //forwarding information ourShaders
-    ourShader.setVec3("lampPointLight1.position", lampPointLight1.position);
-    ourShader.setVec3("lampPointLight1.ambient", lampPointLight1.ambient);
-    ourShader.setVec3("lampPointLight1.diffuse", lampPointLight1.diffuse);
-    ourShader.setVec3("lampPointLight1.specular", lampPointLight1.specular);
-    ourShader.setFloat("lampPointLight1.constant", lampPointLight1.constant);
-    ourShader.setFloat("lampPointLight1.linear", lampPointLight1.linear);
-    ourShader.setFloat("lampPointLight1.quadratic", lampPointLight1.quadratic);
-
-    ourShader.setVec3("lampPointLight2.position", lampPointLight2.position);
-    ourShader.setVec3("lampPointLight2.ambient", lampPointLight2.ambient);
-    ourShader.setVec3("lampPointLight2.diffuse", lampPointLight2.diffuse);
-    ourShader.setVec3("lampPointLight2.specular", lampPointLight2.specular);
-    ourShader.setFloat("lampPointLight2.constant", lampPointLight2.constant);
-    ourShader.setFloat("lampPointLight2.linear", lampPointLight2.linear);
-    ourShader.setFloat("lampPointLight2.quadratic", lampPointLight2.quadratic);
-
-    //dirLight
-    ourShader.setVec3("dirLight.direction", dirLight.direction);
-    ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-    ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-    ourShader.setVec3("dirLight.specular", dirLight.specular);
-
-    //spotlight
-    ourShader.setVec3("lampSpotLight.position", lampSpotLight.position);
-    ourShader.setVec3("lampSpotLight.direction", lampSpotLight.direction);
-    ourShader.setVec3("lampSpotLight.ambient", lampSpotLight.ambient);
-    ourShader.setVec3("lampSpotLight.diffuse", lampSpotLight.diffuse);
-    ourShader.setVec3("lampSpotLight.specular", lampSpotLight.specular);
-    ourShader.setFloat("lampSpotLight.constant", lampSpotLight.constant);
-    ourShader.setFloat("lampSpotLight.linear", lampSpotLight.linear);
-    ourShader.setFloat("lampSpotLight.quadratic", lampSpotLight.quadratic);
-    ourShader.setFloat("lampSpotLight.cutOff", glm::cos(glm::radians(lampSpotLight.cutOff)));
-    ourShader.setFloat("lampSpotLight.outerCutOff", glm::cos(glm::radians(lampSpotLight.outerCutOff)));
-
-    ourShader.setVec3("viewPosition", programState->camera.Position);
-    ourShader.setFloat("material.shininess", 32.0f);
-
-    //for now
-//        ourShader.setVec3("dirLight.direction", 0.3f, -0.75f, -0.6f);
-//        ourShader.setVec3("dirLight.ambient", 0.1f, 0.1f, 0.1f);
-//        ourShader.setVec3("dirLight.diffuse", 0.25f, 0.25f, 0.25f);
-//        ourShader.setVec3("dirLight.specular", 0.3f, 0.3f, 0.3f);
-
-    //forwarding information to blendShader
-    blendShader.use();
-    blendShader.setVec3("lampPointLight1.position", lampPointLight1.position);
-    blendShader.setVec3("lampPointLight1.ambient", lampPointLight1.ambient);
-    blendShader.setVec3("lampPointLight1.diffuse", lampPointLight1.diffuse);
-    blendShader.setVec3("lampPointLight1.specular", lampPointLight1.specular);
-    blendShader.setFloat("lampPointLight1.constant", lampPointLight1.constant);
-    blendShader.setFloat("lampPointLight1.linear", lampPointLight1.linear);
-    blendShader.setFloat("lampPointLight1.quadratic", lampPointLight1.quadratic);
-    blendShader.setVec3("lampPointLight2.position", lampPointLight2.position);
-    blendShader.setVec3("lampPointLight2.ambient", lampPointLight2.ambient);
-    blendShader.setVec3("lampPointLight2.diffuse", lampPointLight2.diffuse);
-    blendShader.setVec3("lampPointLight2.specular", lampPointLight2.specular);
-    blendShader.setFloat("lampPointLight2.constant", lampPointLight2.constant);
-    blendShader.setFloat("lampPointLight2.linear", lampPointLight2.linear);
-    blendShader.setFloat("lampPointLight2.quadratic", lampPointLight2.quadratic);
-    blendShader.setVec3("dirLight.direction", dirLight.direction);
-    blendShader.setVec3("dirLight.ambient", dirLight.ambient);
-    blendShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-    blendShader.setVec3("dirLight.specular", dirLight.specular);
-    blendShader.setVec3("lampSpotLight.position", lampSpotLight.position);
-    blendShader.setVec3("lampSpotLight.direction", lampSpotLight.direction);
-    blendShader.setVec3("lampSpotLight.ambient", lampSpotLight.ambient);
-    blendShader.setVec3("lampSpotLight.diffuse", lampSpotLight.diffuse);
-    blendShader.setVec3("lampSpotLight.specular", lampSpotLight.specular);
-    blendShader.setFloat("lampSpotLight.constant", lampSpotLight.constant);
-    blendShader.setFloat("lampSpotLight.linear", lampSpotLight.linear);
-    blendShader.setFloat("lampSpotLight.quadratic", lampSpotLight.quadratic);
-    blendShader.setFloat("lampSpotLight.cutOff", glm::cos(glm::radians(lampSpotLight.cutOff)));
-    blendShader.setFloat("lampSpotLight.outerCutOff", glm::cos(glm::radians(lampSpotLight.outerCutOff)));
-    blendShader.setVec3("viewPosition", programState->camera.Position);
-    blendShader.setFloat("material.shininess", 32.0f);
-
-    //forwarding information to insideShaders
-    insideShader.use();
-    insideShader.setVec3("lampPointLight1.position", lampPointLight1.position);
-    insideShader.setVec3("lampPointLight1.ambient", lampPointLight1.ambient);
-    insideShader.setVec3("lampPointLight1.diffuse", lampPointLight1.diffuse);
-    insideShader.setVec3("lampPointLight1.specular", lampPointLight1.specular);
-    insideShader.setFloat("lampPointLight1.constant", lampPointLight1.constant);
-    insideShader.setFloat("lampPointLight1.linear", lampPointLight1.linear);
-    insideShader.setFloat("lampPointLight1.quadratic", lampPointLight1.quadratic);
-    insideShader.setVec3("lampPointLight2.position", lampPointLight2.position);
-    insideShader.setVec3("lampPointLight2.ambient", lampPointLight2.ambient);
-    insideShader.setVec3("lampPointLight2.diffuse", lampPointLight2.diffuse);
-    insideShader.setVec3("lampPointLight2.specular", lampPointLight2.specular);
-    insideShader.setFloat("lampPointLight2.constant", lampPointLight2.constant);
-    insideShader.setFloat("lampPointLight2.linear", lampPointLight2.linear);
-    insideShader.setFloat("lampPointLight2.quadratic", lampPointLight2.quadratic);
-
-    insideShader.setVec3("lampSpotLight.position", lampSpotLight.position);
-    insideShader.setVec3("lampSpotLight.direction", lampSpotLight.direction);
-    insideShader.setVec3("lampSpotLight.ambient", lampSpotLight.ambient);
-    insideShader.setVec3("lampSpotLight.diffuse", lampSpotLight.diffuse);
-    insideShader.setVec3("lampSpotLight.specular", lampSpotLight.specular);
-    insideShader.setFloat("lampSpotLight.constant", lampSpotLight.constant);
-    insideShader.setFloat("lampSpotLight.linear", lampSpotLight.linear);
-    insideShader.setFloat("lampSpotLight.quadratic", lampSpotLight.quadratic);
-    insideShader.setFloat("lampSpotLight.cutOff", glm::cos(glm::radians(lampSpotLight.cutOff)));
-    insideShader.setFloat("lampSpotLight.outerCutOff", glm::cos(glm::radians(lampSpotLight.outerCutOff)));
-
-    insideShader.setVec3("viewPosition", programState->camera.Position);
-    insideShader.setFloat("material.shininess", 32.0f);
-
-    //forwarding information to outsideShaders
-    outsideShader.use();
-    outsideShader.setVec3("dirLight.direction", dirLight.direction);
-    outsideShader.setVec3("dirLight.ambient", dirLight.ambient);
-    outsideShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-    outsideShader.setVec3("dirLight.specular", dirLight.specular);
-    outsideShader.setVec3("viewPosition", programState->camera.Position);
-    outsideShader.setFloat("material.shininess", 32.0f);
-
-    glDisable(GL_CULL_FACE);
-
-    // view/projection transformations
-    insideShader.use();
+    // view/projection transformations and lights come from the shared uniform buffers, draws are only queued here and
+    // issued sorted at the end of the frame
     glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                             (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = programState->camera.GetViewMatrix();
-    insideShader.setMat4("projection", projection);
-    insideShader.setMat4("view", view);
+    queue.begin(programState->camera.GetViewMatrix(), projection, 100.0f, (float)SCR_HEIGHT);
 
     // render bed
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(0.0f, 0.0f, -1.0f));
     model = glm::scale(model, glm::vec3(0.9f));
-    insideShader.setMat4("model", model);
-    bed.Draw(insideShader);
+    bed.Submit(queue, insideShader, model);
 
     //render wardrobe
     model = glm::mat4(1.0f);
     model = glm::translate(model,glm::vec3(
             3.0f, 0.0f, -2.27f));
     model = glm::scale(model, glm::vec3(1.3f));
-    insideShader.setMat4("model", model);
-    wardrobe.Draw(insideShader);
+    wardrobe.Submit(queue, insideShader, model);
 
     //render kitchen
     model = glm::mat4(1.0f);
@@ -781,16 +997,14 @@ void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader,
                            glm::vec3(-2.2f, 0.46f, 3.0f));
     model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0, 1, 0));
     model = glm::scale(model, glm::vec3(0.45f));
-    insideShader.setMat4("model", model);
-    kitchen.Draw(insideShader);
+    kitchen.Submit(queue, insideShader, model);
 
     //render rug
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(-0.8f, 0.0f, 1.0f));
     model = glm::scale(model, glm::vec3(1.2f));
-    insideShader.setMat4("model", model);
-    rug.Draw(insideShader);
+    rug.Submit(queue, insideShader, model);
 
     //render tableSet
     model = glm::mat4(1.0f);
@@ -798,8 +1012,7 @@ void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader,
                            glm::vec3(-2.4f, 0.0f, -1.8f));
     model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0, 1, 0));
     model = glm::scale(model, glm::vec3(0.011));
-    insideShader.setMat4("model", model);
-    tableSet.Draw(insideShader);
+    tableSet.Submit(queue, insideShader, model);
 
     //render door
     model = glm::mat4(1.0f);
@@ -808,63 +1021,55 @@ void renderScene(Shader &ourShader, Shader &skyboxShader, Shader &insideShader,
     model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0, 0, 1));
     model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0, 1, 0));
     model = glm::scale(model, glm::vec3(0.009));
-    insideShader.setMat4("model", model);
-    door.Draw(insideShader);
+    door.Submit(queue, insideShader, model);
 
     //render frame
-    insideShader.use();
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(-3.68f, 1.2f, -1.8f));
     model = glm::rotate(model, glm::radians(-17.0f), glm::vec3(0, 0, 1));
     model = glm::scale(model, glm::vec3(1.2f));
-    insideShader.setMat4("model", model);
-    frame.Draw(insideShader);
+    frame.Submit(queue, insideShader, model);
 
     //render vase
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(-2.45f, 0.8f, -1.75f));
     model = glm::scale(model, glm::vec3(1.3f));
-    insideShader.setMat4("model", model);
-    vase.Draw(insideShader);
+    vase.Submit(queue, insideShader, model);
 
     //render lamps
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(-1.0f, 0.51f, -3.27f));
     model = glm::scale(model, glm::vec3(1.0f));
-    insideShader.setMat4("model", model);
-    lamp.Draw(insideShader);
+    lamp.Submit(queue, insideShader, model);
 
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(1.0f, 0.51f, -3.27f));
     model = glm::scale(model, glm::vec3(1.0f));
-    insideShader.setMat4("model", model);
-    lamp2.Draw(insideShader);
+    lamp2.Submit(queue, insideShader, model);
 
     model = glm::mat4(1.0f);
     model = glm::translate(model,
                            glm::vec3(-0.76f, 3.0f, 0.94f));
     model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0, 0, 1));
     model = glm::scale(model, glm::vec3(2.0f));
-    insideShader.setMat4("model", model);
-    lamp3.Draw(insideShader);
+    lamp3.Submit(queue, insideShader, model);
+
+    renderAll(ourShader, skyboxShader, insideShader, outsideShader, outsideInstancedShader, blendShader, normalShader,
+              registry, geometry, materials, queue, tree, forest);
 
-    renderAll(ourShader, skyboxShader, insideShader, outsideShader, blendShader, normalShader,
-              wall, floor, grassDiff, grassSpec, roof, cubemapTexture, path, pathN, pathD, tree, trees);
+    renderWindows(blendShader, registry, geometry, materials, queue);
 
-    renderWindows(blendShader, windows, windows2);
+    queue.flush();
 
     if (programState->ImGuiEnabled)
-        DrawImGui(programState);
+        DrawImGui(programState, queue);
 }
 
-void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &blendShader, Shader &normalShader,
-               unsigned int& wall, unsigned int& floor, unsigned int& grassDiff, unsigned int& grassSpec, unsigned int& roof,
-               unsigned int& cubemapTexture, unsigned int& path, unsigned int& pathN, unsigned int& pathD, Model &tree ,vector<glm::vec3> trees
-               ){
+void buildSceneGeometry(GeometryRegistry& registry, SceneGeometry& geometry) {
 
     //initializing vertices (first three coordinates, second three normals, and two for textures)
     float vertices1[] = {
@@ -1056,159 +1261,67 @@ void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Sh
             0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 12.5f, 25.0f
     };
 
-    // initializing VAOs and VBOs for the room
-    unsigned int VBO, cubeVAO1, cubeVAO2, cubeVAO3, cubeVAO5, cubeVAO6,  cubeVAOP1, cubeVAOP2, cubeVAOP3, windowVAO, window2VAO;
-    glGenVertexArrays(1, &cubeVAO1);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices1), vertices1, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAO1);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &cubeVAO2);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices2), vertices2, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAO2);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &cubeVAO3);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices3), vertices3, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAO3);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &cubeVAO5);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices5), vertices5, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAO5);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &cubeVAO6);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices6), vertices6, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAO6);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    //initializing VAO and VBOs for auxiliary walls
-    glGenVertexArrays(1, &cubeVAOP1);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices2), vertices2, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAOP1);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &cubeVAOP2);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices3), vertices3, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAOP2);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    //initializing VAO and VBO for the kitchen half-wall
-    glGenVertexArrays(1, &cubeVAOP3);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices4), vertices4, GL_STATIC_DRAW);
-    glBindVertexArray(cubeVAOP3);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    //initializing roof VAO and VBO
-    unsigned int roofVAO, roofVBO;
-    glGenVertexArrays(1, &roofVAO);
-    glGenBuffers(1, &roofVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, roofVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(roofVertices), roofVertices, GL_STATIC_DRAW);
-    glBindVertexArray(roofVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    //initializing VAO and VBO for skybox
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    //initializing VAO and VBO for platform and path
-    unsigned int platformVAO, platformVBO, pathVAO, pathVBO;
-    glGenVertexArrays(1, &platformVAO);
-    glGenBuffers(1, &platformVBO);
-    glBindVertexArray(platformVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, platformVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(platformVertices), &platformVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-
-    glGenVertexArrays(1, &pathVAO);
-    glGenBuffers(1, &pathVBO);
-    glBindVertexArray(pathVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, pathVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pathVertices), &pathVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(8 * sizeof(float)));
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
+    // registering the static meshes, every vertex array is uploaded to the GPU only once
+    geometry.cubeBack = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices1, sizeof(vertices1) / sizeof(float));
+    geometry.cubeFront = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices2, sizeof(vertices2) / sizeof(float));
+    geometry.cubeLeft = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices3, sizeof(vertices3) / sizeof(float));
+    geometry.cubeRight = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices4, sizeof(vertices4) / sizeof(float));
+    geometry.cubeBottom = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices5, sizeof(vertices5) / sizeof(float));
+    geometry.cubeTop = registry.add(LAYOUT_POSITION_NORMAL_UV, vertices6, sizeof(vertices6) / sizeof(float));
+    geometry.roof = registry.add(LAYOUT_POSITION_NORMAL_UV, roofVertices, sizeof(roofVertices) / sizeof(float));
+    geometry.platform = registry.add(LAYOUT_POSITION_NORMAL_UV, platformVertices, sizeof(platformVertices) / sizeof(float));
+    geometry.skybox = registry.add(LAYOUT_POSITION, skyboxVertices, sizeof(skyboxVertices) / sizeof(float));
+    geometry.path = registry.add(LAYOUT_POSITION_NORMAL_UV_TANGENT, pathVertices, sizeof(pathVertices) / sizeof(float));
+
+    registry.upload();
+}
+
+void buildSceneMaterials(SceneMaterials& materials, TextureLayer wall, TextureLayer floor, TextureLayer grassDiff, TextureLayer grassSpec,
+                         TextureLayer roof, unsigned int cubemapTexture, unsigned int path, unsigned int pathN, unsigned int pathD,
+                         unsigned int windows, unsigned int windows2) {
+    materials.wall.add(wall.texture, TEXTURE_DIFFUSE, GL_TEXTURE_2D_ARRAY, wall.layer);
+    materials.wall.add(wall.texture, TEXTURE_SPECULAR, GL_TEXTURE_2D_ARRAY, wall.layer);
+    materials.floor.add(floor.texture, TEXTURE_DIFFUSE, GL_TEXTURE_2D_ARRAY, floor.layer);
+    materials.floor.add(floor.texture, TEXTURE_SPECULAR, GL_TEXTURE_2D_ARRAY, floor.layer);
+    materials.grass.add(grassDiff.texture, TEXTURE_DIFFUSE, GL_TEXTURE_2D_ARRAY, grassDiff.layer);
+    materials.grass.add(grassSpec.texture, TEXTURE_SPECULAR, GL_TEXTURE_2D_ARRAY, grassSpec.layer);
+    materials.roof.add(roof.texture, TEXTURE_DIFFUSE, GL_TEXTURE_2D_ARRAY, roof.layer);
+    materials.roof.add(roof.texture, TEXTURE_SPECULAR, GL_TEXTURE_2D_ARRAY, roof.layer);
+    materials.skybox.add(cubemapTexture, TEXTURE_DIFFUSE, GL_TEXTURE_CUBE_MAP);
+    materials.path.add(path, TEXTURE_DIFFUSE);
+    materials.path.add(pathN, TEXTURE_NORMAL);
+    materials.path.add(pathD, TEXTURE_HEIGHT);
+    materials.windows.add(windows, TEXTURE_DIFFUSE);
+    materials.windows.add(windows, TEXTURE_SPECULAR);
+    materials.windows2.add(windows2, TEXTURE_DIFFUSE);
+    materials.windows2.add(windows2, TEXTURE_SPECULAR);
+
+    // the static shaders name their samplers like the model shaders
+    Material* prefixed[] = {&materials.wall, &materials.floor, &materials.grass, &materials.roof, &materials.windows, &materials.windows2};
+    for (Material* material : prefixed)
+        material->setPrefix("material.");
+}
+
+DrawCommand staticDraw(GeometryRegistry& registry, GeometryHandle handle, Shader& shader, const Material& material,
+                       const glm::mat4& model, const RenderState& state, RenderPass pass) {
+    const StaticMesh& mesh = registry.get(handle);
+    DrawCommand command;
+    command.pass = pass;
+    command.shader = &shader;
+    command.material = &material;
+    command.vao = registry.getVertexArray(handle);
+    command.first = mesh.first;
+    command.count = mesh.count;
+    command.hasModel = true;
+    command.model = model;
+    command.state = state;
+    command.uvDensity = mesh.uvDensity;
+    return command;
+}
+
+void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Shader &outsideShader, Shader &outsideInstancedShader, Shader &blendShader, Shader &normalShader,
+               GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue, Model &tree,
+               Forest& forest){
 
     //room scaling
     glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
@@ -1219,258 +1332,83 @@ void renderAll(Shader &ourShader, Shader &skyboxShader, Shader &insideShader, Sh
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(0, 1.5, 0));
     model = glm::scale(model, glm::vec3(7, 3, 7));
-    ourShader.setMat4("model", model);
 
     //draw room
-    ourShader.use();
-    ourShader.setMat4("projection", projection);
-    ourShader.setMat4("view", view);
-    ourShader.setMat4("model", model);
-    glBindVertexArray(cubeVAO2);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(cubeVAO3);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(cubeVAO5);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, floor);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, floor);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(cubeVAO6);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    queue.submit(staticDraw(registry, geometry.cubeFront, ourShader, materials.wall, model), registry.get(geometry.cubeFront).bounds);
+    queue.submit(staticDraw(registry, geometry.cubeLeft, ourShader, materials.wall, model), registry.get(geometry.cubeLeft).bounds);
+    queue.submit(staticDraw(registry, geometry.cubeBottom, ourShader, materials.floor, model), registry.get(geometry.cubeBottom).bounds);
+    queue.submit(staticDraw(registry, geometry.cubeTop, ourShader, materials.wall, model), registry.get(geometry.cubeTop).bounds);
 
     //draw half-wall
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(-1.51f, 1.48f, 1.76f));
     model = glm::scale(model, glm::vec3(7, 3, 3.5));
-    insideShader.use();
-    insideShader.setMat4("projection", projection);
-    insideShader.setMat4("view", view);
-    insideShader.setMat4("model", model);
-    glBindVertexArray(cubeVAOP3);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    queue.submit(staticDraw(registry, geometry.cubeRight, insideShader, materials.wall, model), registry.get(geometry.cubeRight).bounds);
 
     //draw auxiliary walls
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(-0.1f, 1.5f, 0.02f));
     model = glm::scale(model, glm::vec3(7, 3, 7));
-    ourShader.use();
-    ourShader.setMat4("projection", projection);
-    ourShader.setMat4("view", view);
-    ourShader.setMat4("model", model);
-    glBindVertexArray(cubeVAOP1);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(cubeVAOP2);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, wall);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    glEnable(GL_CULL_FACE);
-
-    // draw skybox
-    glCullFace(GL_FRONT);
-    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    queue.submit(staticDraw(registry, geometry.cubeFront, ourShader, materials.wall, model), registry.get(geometry.cubeFront).bounds);
+    queue.submit(staticDraw(registry, geometry.cubeLeft, ourShader, materials.wall, model), registry.get(geometry.cubeLeft).bounds);
+
+    // draw skybox, drawn after the opaque pass with front faces culled and depth test passing when values are equal
+    // to depth buffer's content
     skyboxShader.use();
     view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
     skyboxShader.setMat4("view", view);
     skyboxShader.setMat4("projection", projection);
-    glBindVertexArray(skyboxVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glDepthFunc(GL_LESS); // set depth function back to default
+    DrawCommand skybox = staticDraw(registry, geometry.skybox, skyboxShader, materials.skybox, glm::mat4(1.0f),
+                                    RenderState(true, GL_FRONT, GL_LEQUAL), PASS_SKY);
+    skybox.hasModel = false;
+    queue.submit(skybox);
 
     //draw platform
-    glCullFace(GL_BACK);
-    outsideShader.use();
-    projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
     view = programState->camera.GetViewMatrix();
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(0.0f, -0.001f, 0.0f));
     model = glm::scale(model, glm::vec3(25.0f, 1.0f, 25.0f));
-    outsideShader.setMat4("projection", projection);
-    outsideShader.setMat4("view", view);
-    glBindVertexArray(platformVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, grassDiff);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, grassSpec);
-    outsideShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    //draw roof
-    glDisable(GL_CULL_FACE);
-    outsideShader.use();
+    queue.submit(staticDraw(registry, geometry.platform, outsideShader, materials.grass, model, RenderState(true, GL_BACK)), registry.get(geometry.platform).bounds);
+
+    //draw roof, only the first 12 vertices are used
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(0.0f, 6.2f, 0.1f));
     model = glm::scale(model, glm::vec3(8.05));
-    outsideShader.setMat4("projection", projection);
-    outsideShader.setMat4("view", view);
-    outsideShader.setMat4("model", model);
-    glBindVertexArray(roofVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, roof);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, roof);
-    glDrawArrays(GL_TRIANGLES, 0, 12);
-
-    //draw trees
-    for (auto i : trees)
-    {
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(1.0f));
-        model = glm::translate(model, i);
-        outsideShader.setMat4("model", model);
-        tree.Draw(outsideShader);
-    }
+    DrawCommand roof = staticDraw(registry, geometry.roof, outsideShader, materials.roof, model);
+    roof.count = 12;
+    queue.submit(roof, registry.get(geometry.roof).bounds);
+
+    //draw trees, the visible part of the forest is a single instanced draw per tree mesh
+    forest.visible.clear();
+    forest.visibleTransforms.clear();
+    queue.getFrustum().cull(forest.bounds, forest.visible);
+    for (unsigned int index : forest.visible)
+        forest.visibleTransforms.push_back(forest.transforms[index]);
+    queue.addCullStats(forest.visible.size(), forest.transforms.size() - forest.visible.size());
+    tree.SetInstanceTransforms(forest.visibleTransforms.empty() ? nullptr : &forest.visibleTransforms[0], forest.visibleTransforms.size());
+    tree.SubmitInstanced(queue, outsideInstancedShader);
 
     //draw path
     normalShader.use();
+    normalShader.setMat4("projection", projection);
+    normalShader.setMat4("view", view);
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(4.0f, 0.001f, 2.5f));
     model = glm::scale(model, glm::vec3(0.5f));
-    normalShader.setMat4("projection", projection);
-    normalShader.setMat4("view", view);
-    normalShader.setMat4("model", model);
-    glBindVertexArray(pathVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, path);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, pathN);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, pathD);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
-    normalShader.setMat4("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    for (unsigned int i = 0; i < 13; i++) {
+        queue.submit(staticDraw(registry, geometry.path, normalShader, materials.path, model), registry.get(geometry.path).bounds);
+        model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
+    }
 }
 
-void renderWindows(Shader& blendShader, unsigned int& windows, unsigned int& windows2) {
-    float vertices1[] = {
-            -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-            0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f,1.0f, 0.0f,
-            0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
-            0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f,
-            -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f,
-            -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f,
-    };
-
-    float vertices4[] = {
-            0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-            0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-            0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-            0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f,
-            0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-            0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-    };
-
-    unsigned int VBO, windowVAO, window2VAO;
-    //window walls
-    glGenVertexArrays(1, &windowVAO);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices4), vertices4, GL_STATIC_DRAW);
-    glBindVertexArray(windowVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    glGenVertexArrays(1, &window2VAO);
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices1), vertices1, GL_STATIC_DRAW);
-    glBindVertexArray(window2VAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
+void renderWindows(Shader& blendShader, GeometryRegistry& registry, SceneGeometry& geometry, SceneMaterials& materials, RenderQueue& queue) {
     //draw window wall
-    glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                            (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = programState->camera.GetViewMatrix();
     glm::mat4 model = glm::mat4(1.0f);
 
     model = glm::mat4(1);
     model = glm::translate(model, glm::vec3(0, 1.5, 0));
     model = glm::scale(model, glm::vec3(7, 3, 7));
-    blendShader.setMat4("model", model);
-    blendShader.use();
-    blendShader.setMat4("projection", projection);
-    blendShader.setMat4("view", view);
-    blendShader.setMat4("model", model);
-    glBindVertexArray(window2VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, windows2);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, windows2);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(windowVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, windows);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, windows);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-}
\ No newline at end of file
+    queue.submit(staticDraw(registry, geometry.cubeBack, blendShader, materials.windows2, model, RenderState(), PASS_TRANSPARENT), registry.get(geometry.cubeBack).bounds);
+    queue.submit(staticDraw(registry, geometry.cubeRight, blendShader, materials.windows, model, RenderState(), PASS_TRANSPARENT), registry.get(geometry.cubeRight).bounds);
+
+}